@@ -59,14 +59,27 @@
 #define __VSPM_IF_LOCAL_H__
 
 #include <linux/sched.h>
+#include <linux/llist.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/dma-fence.h>
+#include <linux/version.h>
 
 extern struct platform_device *g_vspmif_pdev;
+extern struct workqueue_struct *g_vspmif_wq;
 
 /* define assigned memory size */
-#define VSPM_IF_MEM_SIZE			(24576)
-#define VSPM_IF_RPF_CLUT_SIZE		(2048)
 #define VSPM_IF_HGO_SIZE			(1280)
 #define VSPM_IF_HGT_SIZE			(1024)
+#define VSPM_IF_DL_SIZE			(8192)	/* default of dl_size */
+#define VSPM_IF_TBL_SIZE \
+	(5 * 256 * 8 + VSPM_IF_HGO_SIZE + VSPM_IF_HGT_SIZE)
+
+/* work buffer size classes (4 KiB, 8 KiB, ..., 64 KiB) */
+#define VSPM_IF_WORK_MIN_SIZE		(4096)
+#define VSPM_IF_WORK_CLASS_NUM		(5)
+#define VSPM_IF_WORK_ALIGN		(256)
+#define VSPM_IF_WORK_MAG_SIZE		(8)	/* per-CPU cache of a class */
 
 /* define macro */
 #define IPRINT(fmt, args...) \
@@ -89,13 +102,123 @@ struct vspm_if_work_buff_t {
 	void *virt_addr;
 	unsigned int use_flag;
 	unsigned int offset;
-	void *next_buff;
+	unsigned int size;
+	unsigned int size_class;
+	void *next_buff;	/* next unused work buffer in the pool */
+	dma_addr_t tbl_hard;	/* cached area of color tables and histogram */
+	void *tbl_virt;
+	unsigned int tbl_offset;
+};
+
+/* pool of unused work buffers (shared by all file handles) */
+struct vspm_if_work_pool_t {
+	spinlock_t lock;
+	struct vspm_if_work_buff_t *free_buff[VSPM_IF_WORK_CLASS_NUM];
+	unsigned int free_num[VSPM_IF_WORK_CLASS_NUM];
+	unsigned int free_min[VSPM_IF_WORK_CLASS_NUM];	/* in interval */
+	atomic_t total_kb;	/* size of all work buffers */
+	struct delayed_work decay;
+};
+
+/* coherent region carved into work buffers (buddy of size classes) */
+struct vspm_if_work_arena_t {
+	spinlock_t lock;
+	dma_addr_t hard_addr;
+	void *virt_addr;
+	unsigned int num;	/* number of blocks of the minimum size */
+	struct vspm_if_work_buff_t *buff;	/* descriptor of each block */
+	unsigned long *free_map[VSPM_IF_WORK_CLASS_NUM];
+};
+
+/* per-CPU cache of unused work buffers */
+struct vspm_if_work_mag_t {
+	unsigned int num[VSPM_IF_WORK_CLASS_NUM];
+	struct vspm_if_work_buff_t
+		*buff[VSPM_IF_WORK_CLASS_NUM][VSPM_IF_WORK_MAG_SIZE];
+};
+
+/* flat job descriptor */
+struct vspm_if_flat_t {
+	const unsigned char *buff;
+	unsigned int size;
+};
+
+/* callback data structure */
+struct vspm_if_cb_data_t {
+	struct list_head list;
+	struct vspm_if_cb_rsp_t rsp;
+	struct vspm_cb_vsp_hgo {
+		void *virt_addr;
+		void *user_addr;
+	} vsp_hgo;
+	struct vspm_cb_vsp_hgt {
+		void *virt_addr;
+		void *user_addr;
+	} vsp_hgt;
+};
+
+/* cached mapping of dma-buf */
+struct vspm_if_dmabuf_map_t {
+	struct list_head list;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	dma_addr_t hard_addr;
+	atomic_t use;	/* number of jobs using the mapping */
+};
+
+/* job dependency graph */
+struct vspm_if_graph_t {
+	struct vspm_if_private_t *priv;
+	spinlock_t lock;	/* protects the bit masks of jobs */
+	unsigned int num;
+	unsigned int pending;	/* jobs not entried yet */
+	unsigned int done;	/* jobs ended */
+	unsigned int failed;	/* jobs failed or cancelled */
+	unsigned int dep[VSPM_IF_GRAPH_MAX];
+	struct vspm_if_entry_data_t *entry[VSPM_IF_GRAPH_MAX];
+	unsigned long job_id[VSPM_IF_GRAPH_MAX];	/* 0: not entried */
+	struct work_struct work;
+	atomic_t ref;
+};
+
+/* wait for input fences */
+struct vspm_if_fence_wait_t {
+	struct vspm_if_entry_data_t *entry_data;
+	atomic_t pending;	/* fences not signaled, and the entry */
+	int error;
+	unsigned int num;
+	struct work_struct work;
+	struct vspm_if_fence_cb_t {
+		struct dma_fence_cb cb;
+		struct dma_fence *fence;
+		struct vspm_if_fence_wait_t *wait;
+	} in[VSPM_IF_FENCE_IN_MAX];
+};
+
+/* state of synchronous entry */
+enum {
+	VSPM_IF_SYNC_NONE = 0,
+	VSPM_IF_SYNC_WAIT,
+	VSPM_IF_SYNC_DONE,
+	VSPM_IF_SYNC_ABANDONED,
 };
 
 /* entry data structure */
 struct vspm_if_entry_data_t {
 	struct list_head list;
+	struct llist_node node;	/* handoff from callback */
 	struct vspm_if_private_t *priv;
+	struct vspm_if_template_t *tmpl;
+	struct vspm_if_cb_data_t cb_data;	/* completion record */
+	atomic_t sync_state;
+	struct completion sync_done;
+	struct vspm_if_graph_t *graph;
+	unsigned int graph_index;
+	struct dma_fence *out_fence;	/* signaled at the end of the job */
+	struct vspm_if_fence_wait_t *fence_wait;	/* job is held */
+	struct vspm_if_dmabuf_map_t *dmabuf[VSPM_IF_DMABUF_MAX];
+	unsigned int dmabuf_num;
 	struct vspm_if_entry_t entry;
 	struct vspm_job_t job;
 	union {
@@ -166,46 +289,105 @@ struct vspm_if_entry_data_t {
 	} ip_par;
 };
 
-/* callback data structure */
-struct vspm_if_cb_data_t {
+/* template structure */
+struct vspm_if_template_t {
 	struct list_head list;
-	struct vspm_if_cb_rsp_t rsp;
-	struct vspm_cb_vsp_hgo {
-		void *virt_addr;
-		void *user_addr;
-	} vsp_hgo;
-	struct vspm_cb_vsp_hgt {
-		void *virt_addr;
-		void *user_addr;
-	} vsp_hgt;
-	struct vspm_if_work_buff_t *vsp_work_buff;
+	unsigned int handle;
+	unsigned int use_flag;
+	struct vspm_if_entry_data_t *entry_data;
 };
 
 /* private data structure */
 struct vspm_if_private_t {
 	spinlock_t lock;	/* protects the entry list and callback list */
-	struct task_struct *thread;
 	struct vspm_if_entry_data_t entry_data;
 	struct vspm_if_cb_data_t cb_data;
-	struct completion wait_interrupt;
+	struct llist_head cb_llist;	/* finished entries from callback */
+	struct llist_head free_llist;	/* entries posted to completion ring */
+	atomic_t cb_num;	/* number of responses not received */
 	struct completion wait_thread;
+	wait_queue_head_t wait_poll;
 	struct semaphore sem;
-	struct vspm_if_work_buff_t *work_buff;
+	atomic_t work_kb;	/* size of work buffers in use */
+	struct vspm_if_work_buff_t *rsv_buff;	/* reserved work buffers */
+	unsigned int rsv_num;
+	unsigned int rsv_max;
+	unsigned int rsv_class;
+	struct list_head tmpl_list;
+	unsigned int tmpl_handle;
+	struct vspm_if_entry_data_t *entry_slot;
+	unsigned int slot_num;
+	unsigned int slot_used;
+	struct list_head slot_list;
+	spinlock_t cq_lock;	/* protects the completion ring producer */
+	struct vspm_if_cq_t *cq;
+	unsigned int cq_tail;
+	struct semaphore sq_sem;	/* protects the submission ring */
+	struct vspm_if_sq_t *sq;
+	unsigned int sq_head;
+	unsigned int stop_flag;	/* stop request for the next receiver */
+	unsigned int stop_gen;	/* generation of stop request */
+	unsigned int waiters;	/* number of receivers */
+	unsigned int thread_ready;	/* notified to WAIT_THREAD */
+	unsigned int closing;	/* no more graph jobs are entried */
+	u64 fence_context;
+	atomic_t fence_seqno;
+	struct semaphore dmabuf_sem;	/* protects the dma-buf cache */
+	struct list_head dmabuf_list;	/* most recently used first */
+	unsigned int dmabuf_num;
 	void *handle;
 };
 
 /* sub function */
+int get_entry_data(
+	struct vspm_if_private_t *priv,
+	struct vspm_if_entry_data_t **entry_data);
+void put_entry_data(struct vspm_if_entry_data_t *entry_data);
+void reclaim_entry_data(struct vspm_if_private_t *priv);
+void collect_cb_data(struct vspm_if_private_t *priv);
 void release_all_entry_data(struct vspm_if_private_t *priv);
 void release_all_cb_data(struct vspm_if_private_t *priv);
+void put_graph(struct vspm_if_graph_t *graph);
+struct dma_fence *create_out_fence(struct vspm_if_private_t *priv);
+void signal_out_fence(struct vspm_if_entry_data_t *entry_data, int error);
+void put_fence_wait(struct vspm_if_fence_wait_t *wait);
+void cancel_fence_waits(struct vspm_if_private_t *priv);
+int set_dmabuf_par(
+	struct vspm_if_entry_data_t *entry, struct vspm_if_dmabuf_t *import);
+void release_all_dmabuf_maps(struct vspm_if_private_t *priv);
+
+struct vspm_if_template_t *find_template(
+	struct vspm_if_private_t *priv, unsigned int handle);
+int release_template(struct vspm_if_private_t *priv, unsigned int handle);
+void release_all_templates(struct vspm_if_private_t *priv);
 
-struct vspm_if_work_buff_t *get_work_buffer(struct vspm_if_private_t *priv);
-void release_work_buffers(struct vspm_if_private_t *priv);
+int map_cq(struct vspm_if_private_t *priv, struct vm_area_struct *vma);
+void release_cq(struct vspm_if_private_t *priv);
+int map_sq(struct vspm_if_private_t *priv, struct vm_area_struct *vma);
+void release_sq(struct vspm_if_private_t *priv);
+int post_cq(
+	struct vspm_if_private_t *priv, struct vspm_if_cb_data_t *cb_data);
+int is_cq_empty(struct vspm_if_private_t *priv);
 
-int free_vsp_par(struct vspm_entry_vsp *vsp);
+int get_work_buffer(
+	struct vspm_if_private_t *priv,
+	unsigned int size,
+	struct vspm_if_work_buff_t **work_buff);
+void put_work_buffer(
+	struct vspm_if_private_t *priv, struct vspm_if_work_buff_t *work_buff);
+void sync_work_buffer_for_device(struct vspm_if_work_buff_t *work_buff);
+int set_entry_depth(
+	struct vspm_if_private_t *priv, unsigned int num, unsigned int size);
+int init_work_pool(void);
+void release_work_pool(void);
+
+int free_vsp_par(
+	struct vspm_if_private_t *priv, struct vspm_entry_vsp *vsp);
 int set_vsp_par(
 	struct vspm_if_entry_data_t *entry,
 	struct vsp_start_t *vsp_par);
-int free_cb_vsp_par(struct vspm_if_cb_data_t *cb_data);
+void put_cb_data(struct vspm_if_cb_data_t *cb_data);
+void copy_cb_histogram(struct vspm_if_cb_data_t *cb_data);
 void set_cb_rsp_vsp(
 	struct vspm_if_cb_data_t *cb_data,
 	struct vspm_if_entry_data_t *entry_data);
@@ -213,8 +395,22 @@ int set_fdp_par(
 	struct vspm_if_entry_data_t *entry,
 	struct fdp_start_t *fdp_par);
 
-int set_compat_vsp_par(struct vspm_if_entry_data_t *entry, unsigned int src);
-int set_compat_fdp_par(struct vspm_if_entry_data_t *entry, unsigned int src);
+int set_patch_par(
+	struct vspm_if_entry_data_t *entry, struct vspm_if_patch_t *patch);
+
+int set_compat_vsp_par(
+	struct vspm_if_entry_data_t *entry,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat);
+int set_compat_fdp_par(
+	struct vspm_if_entry_data_t *entry,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat);
+
+int set_flat_par(
+	struct vspm_if_entry_data_t *entry,
+	struct vspm_if_entry_flat_req_t *req,
+	struct vspm_if_sq_t *sq);
 
 #endif /* __VSPM_IF_LOCAL_H__ */
 
@@ -64,6 +64,14 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/dma-fence.h>
+#include <linux/sync_file.h>
+#include <linux/file.h>
 #include <linux/ioctl.h>
 
 #include "vspm_public.h"
@@ -71,6 +79,7 @@
 #include "vspm_if_local.h"
 
 struct platform_device *g_vspmif_pdev;
+struct workqueue_struct *g_vspmif_wq;
 
 static int open(struct inode *inode, struct file *file)
 {
@@ -83,35 +92,74 @@ static int open(struct inode *inode, struct file *file)
 
 	/* init */
 	spin_lock_init(&priv->lock);
-	init_completion(&priv->wait_interrupt);
+	spin_lock_init(&priv->cq_lock);
+	init_llist_head(&priv->cb_llist);
+	init_llist_head(&priv->free_llist);
 	init_completion(&priv->wait_thread);
+	init_waitqueue_head(&priv->wait_poll);
 	INIT_LIST_HEAD(&priv->entry_data.list);
 	INIT_LIST_HEAD(&priv->cb_data.list);
+	INIT_LIST_HEAD(&priv->tmpl_list);
+	INIT_LIST_HEAD(&priv->slot_list);
 	sema_init(&priv->sem, 1);
+	sema_init(&priv->sq_sem, 1);
+	priv->fence_context = dma_fence_context_alloc(1);
+	sema_init(&priv->dmabuf_sem, 1);
+	INIT_LIST_HEAD(&priv->dmabuf_list);
 
 	file->private_data = priv;
 	return 0;
 }
 
+static void vspm_if_set_closing(
+	struct vspm_if_private_t *priv, unsigned int closing)
+{
+	unsigned long lock_flag;
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	priv->closing = closing;
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+}
+
 static int close(struct inode *inode, struct file *file)
 {
 	struct vspm_if_private_t *priv =
 		(struct vspm_if_private_t *)file->private_data;
 
 	if (priv) {
+		/* cancel the graph jobs and held jobs not entried yet */
+		vspm_if_set_closing(priv, 1);
+		cancel_fence_waits(priv);
+		flush_workqueue(g_vspmif_wq);
+
 		if (priv->handle) {
 			(void)vspm_quit_driver(priv->handle);
 			priv->handle = NULL;
 		}
 
+		/* wait for the workers queued by the last callbacks */
+		flush_workqueue(g_vspmif_wq);
+
 		/* release entry data */
 		release_all_entry_data(priv);
 
 		/* release callback data */
 		release_all_cb_data(priv);
 
-		/* release work buffer */
-		release_work_buffers(priv);
+		/* release templates */
+		release_all_templates(priv);
+
+		/* release dma-buf cache */
+		release_all_dmabuf_maps(priv);
+
+		/* release completion ring */
+		release_cq(priv);
+
+		/* release submission ring */
+		release_sq(priv);
+
+		/* release entry slots and reserved work buffers */
+		(void)set_entry_depth(priv, 0, 0);
 
 		/* release memory */
 		kfree(priv);
@@ -173,6 +221,7 @@ static long vspm_ioctl_init(
 	}
 
 	priv->handle = handle;
+	vspm_if_set_closing(priv, 0);
 	return 0;
 }
 
@@ -180,102 +229,294 @@ static long vspm_ioctl_quit(struct vspm_if_private_t *priv)
 {
 	long ercd;
 
+	/* cancel the graph jobs and held jobs not entried yet */
+	vspm_if_set_closing(priv, 1);
+	cancel_fence_waits(priv);
+	flush_workqueue(g_vspmif_wq);
+
 	/* finalize VSP manager */
 	ercd = vspm_quit_driver(priv->handle);
-	if (ercd != R_VSPM_OK)
+	if (ercd != R_VSPM_OK) {
+		vspm_if_set_closing(priv, 0);
 		return -EFAULT;
+	}
 
 	priv->handle = NULL;
 
+	/* wait for the workers queued by the last callbacks */
+	flush_workqueue(g_vspmif_wq);
+
 	/* release entry data */
 	release_all_entry_data(priv);
 
 	return 0;
 }
 
-static void vspm_cb_func(
-	unsigned long job_id, long result, void *user_data)
+static void vspm_if_finish_entry(
+	struct vspm_if_entry_data_t *entry_data,
+	unsigned long job_id,
+	long result,
+	long ercd)
 {
-	struct vspm_if_entry_data_t *entry_data =
-		(struct vspm_if_entry_data_t *)user_data;
-
-	struct vspm_if_private_t *priv;
+	struct vspm_if_private_t *priv = entry_data->priv;
 	struct vspm_if_cb_data_t *cb_data;
-	unsigned long lock_flag;
-
-	if (!entry_data)
-		return;
-
-	priv = entry_data->priv;
-
-	/* del list */
-	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_del(&entry_data->list);
-	spin_unlock_irqrestore(&priv->lock, lock_flag);
 
-	/* allocate callback data */
-	cb_data = kzalloc(sizeof(struct vspm_if_cb_data_t), GFP_ATOMIC);
-	if (!cb_data) {
-		EPRINT("CB: failed to allocate memory\n");
-		/* release memory */
-		if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
-			free_vsp_par(&entry_data->ip_par.vsp);
-		kfree(entry_data);
-		return;
-	}
+	/* the callback data is embedded in the entry data */
+	cb_data = &entry_data->cb_data;
+	memset(cb_data, 0, sizeof(struct vspm_if_cb_data_t));
 
 	/* make response data */
-	cb_data->rsp.ercd = 0;
+	cb_data->rsp.ercd = ercd;
 	cb_data->rsp.cb_func = entry_data->entry.req.cb_func;
 	cb_data->rsp.job_id = job_id;
 	cb_data->rsp.result = result;
 	cb_data->rsp.user_data = entry_data->entry.req.user_data;
 
-	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO) {
+	if (!ercd && entry_data->job.type == VSPM_TYPE_VSP_AUTO) {
 		/* set callback response of vsp */
 		set_cb_rsp_vsp(cb_data, entry_data);
 	}
 
-	/* addition list */
-	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_add_tail(&cb_data->list, &priv->cb_data.list);
-	spin_unlock_irqrestore(&priv->lock, lock_flag);
+	/* signal the output fence before the response is handed over */
+	if (entry_data->out_fence) {
+		signal_out_fence(
+			entry_data, (ercd || result != R_VSPM_OK) ? -EIO : 0);
+	}
+
+	/* synchronous entry */
+	if (atomic_read(&entry_data->sync_state) != VSPM_IF_SYNC_NONE) {
+		if (atomic_cmpxchg(
+				&entry_data->sync_state,
+				VSPM_IF_SYNC_WAIT,
+				VSPM_IF_SYNC_DONE) == VSPM_IF_SYNC_WAIT) {
+			/* the waiter releases the entry data */
+			complete(&entry_data->sync_done);
+		} else {
+			/* the waiter was interrupted */
+			llist_add(&entry_data->node, &priv->free_llist);
+		}
+		return;
+	}
+
+	/*
+	 * hand over the entry data without priv->lock, the entry list and
+	 * the callback list are updated by the receiver (collect_cb_data)
+	 * or by the next entry (reclaim_entry_data).
+	 */
+	if (post_cq(priv, cb_data)) {
+		atomic_inc(&priv->cb_num);
+		llist_add(&entry_data->node, &priv->cb_llist);
+	} else {
+		/* the entry data is not needed after posted to ring */
+		llist_add(&entry_data->node, &priv->free_llist);
+	}
 
-	complete(&priv->wait_interrupt);
-	kfree(entry_data);
+	wake_up_interruptible(&priv->wait_poll);
 }
 
-static long vspm_ioctl_entry(
-	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+static void vspm_if_graph_done(
+	struct vspm_if_graph_t *graph, unsigned int index, int failed)
+{
+	unsigned long lock_flag;
+	unsigned int pending;
+
+	spin_lock_irqsave(&graph->lock, lock_flag);
+	graph->done |= BIT(index);
+	if (failed)
+		graph->failed |= BIT(index);
+	pending = graph->pending;
+	spin_unlock_irqrestore(&graph->lock, lock_flag);
+
+	/*
+	 * vspm_entry_job() can sleep, the dependent jobs are entried
+	 * by the worker instead of the callback.
+	 */
+	if (pending) {
+		atomic_inc(&graph->ref);
+		if (!queue_work(g_vspmif_wq, &graph->work))
+			put_graph(graph);
+	}
+}
+
+static void vspm_cb_func(
+	unsigned long job_id, long result, void *user_data)
+{
+	struct vspm_if_entry_data_t *entry_data =
+		(struct vspm_if_entry_data_t *)user_data;
+
+	if (!entry_data)
+		return;
+
+	/* release the dependent jobs before the entry data is handed over */
+	if (entry_data->graph) {
+		vspm_if_graph_done(
+			entry_data->graph,
+			entry_data->graph_index,
+			result != R_VSPM_OK);
+	}
+
+	vspm_if_finish_entry(entry_data, job_id, result, 0);
+}
+
+static void vspm_if_run_graph(struct vspm_if_graph_t *graph)
 {
+	struct vspm_if_private_t *priv = graph->priv;
 	struct vspm_if_entry_data_t *entry_data;
 	struct vspm_if_entry_req_t *entry_req;
-	struct vspm_if_entry_t entry;
 
+	unsigned long job_id;
 	unsigned long lock_flag;
-	int ercd = 0;
+	unsigned int i;
+	long ercd;
+	int cancel;
+
+	for (;;) {
+		/* find a job which is ready or has a failed dependency */
+		cancel = 0;
+		spin_lock_irqsave(&graph->lock, lock_flag);
+		for (i = 0; i < graph->num; i++) {
+			if (!(graph->pending & BIT(i)))
+				continue;
+			if (graph->dep[i] & graph->failed) {
+				cancel = 1;
+				break;
+			}
+			if ((graph->dep[i] & graph->done) == graph->dep[i])
+				break;
+		}
+		if (i == graph->num) {
+			spin_unlock_irqrestore(&graph->lock, lock_flag);
+			break;
+		}
+		graph->pending &= ~BIT(i);
+		spin_unlock_irqrestore(&graph->lock, lock_flag);
 
-	/* allocate entry data */
-	entry_data = kzalloc(sizeof(struct vspm_if_entry_data_t), GFP_KERNEL);
-	if (!entry_data)
-		return -ENOMEM;
-	entry_data->priv = priv;
+		entry_data = graph->entry[i];
+		entry_req = &entry_data->entry.req;
+
+		if (cancel || priv->closing || !priv->handle) {
+			/* not entried, positive errno */
+			ercd = ECANCELED;
+		} else {
+			/* entry job */
+			ercd = vspm_entry_job(
+				priv->handle,
+				&job_id,
+				entry_req->priority,
+				entry_req->job_param,
+				(void *)entry_data,
+				vspm_cb_func);
+			if (ercd == R_VSPM_OK) {
+				spin_lock_irqsave(&graph->lock, lock_flag);
+				graph->job_id[i] = job_id;
+				spin_unlock_irqrestore(&graph->lock, lock_flag);
+				continue;
+			}
+		}
+
+		/* the job ends without entry */
+		spin_lock_irqsave(&graph->lock, lock_flag);
+		graph->done |= BIT(i);
+		graph->failed |= BIT(i);
+		spin_unlock_irqrestore(&graph->lock, lock_flag);
+
+		vspm_if_finish_entry(entry_data, 0, 0, ercd);
+	}
+}
+
+static void vspm_if_graph_work(struct work_struct *work)
+{
+	struct vspm_if_graph_t *graph =
+		container_of(work, struct vspm_if_graph_t, work);
+
+	vspm_if_run_graph(graph);
+	put_graph(graph);
+}
+
+static void vspm_if_fence_func(struct dma_fence *fence, struct dma_fence_cb *cb)
+{
+	struct vspm_if_fence_cb_t *in =
+		container_of(cb, struct vspm_if_fence_cb_t, cb);
+	struct vspm_if_fence_wait_t *wait = in->wait;
+
+	if (fence->error)
+		wait->error = -ECANCELED;
+
+	/* vspm_entry_job() can sleep, the job is entried by the worker */
+	if (atomic_dec_and_test(&wait->pending))
+		queue_work(g_vspmif_wq, &wait->work);
+}
+
+static void vspm_if_fence_work(struct work_struct *work)
+{
+	struct vspm_if_fence_wait_t *wait =
+		container_of(work, struct vspm_if_fence_wait_t, work);
+	struct vspm_if_entry_data_t *entry_data = wait->entry_data;
+	struct vspm_if_private_t *priv = entry_data->priv;
+	struct vspm_if_entry_req_t *entry_req = &entry_data->entry.req;
+
+	unsigned long job_id;
+	unsigned long lock_flag;
+	long ercd;
 
-	/* add list */
 	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_add_tail(&entry_data->list, &priv->entry_data.list);
+	entry_data->fence_wait = NULL;
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
 
-	/* copy entry parameter */
-	if (copy_from_user(
-			&entry_data->entry,
-			(void __user *)arg,
-			_IOC_SIZE(cmd))) {
-		EPRINT("ENTRY: failed to copy the entry parameter\n");
-		ercd = -EFAULT;
-		goto err_exit;
+	if (wait->error || priv->closing || !priv->handle) {
+		/* not entried, positive errno */
+		ercd = ECANCELED;
+	} else {
+		/* entry job */
+		ercd = vspm_entry_job(
+			priv->handle,
+			&job_id,
+			entry_req->priority,
+			entry_req->job_param,
+			(void *)entry_data,
+			vspm_cb_func);
+	}
+
+	/* the job ends without entry */
+	if (ercd != R_VSPM_OK)
+		vspm_if_finish_entry(entry_data, 0, 0, ercd);
+
+	put_fence_wait(wait);
+}
+
+static long vspm_ioctl_config(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_config_t config;
+
+	/* copy configuration parameter */
+	if (copy_from_user(&config, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("CONFIG: failed to copy the parameter\n");
+		return -EFAULT;
 	}
 
+	if (config.depth > VSPM_IF_DEPTH_MAX)
+		return -EINVAL;
+
+	/* allocate entry slots and work buffers */
+	return set_entry_depth(priv, config.depth, config.work_size);
+}
+
+static int vspm_if_entry(
+	struct vspm_if_private_t *priv, struct vspm_if_entry_t *entry)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_req_t *entry_req;
+
+	unsigned long lock_flag;
+	int ercd = 0;
+
+	/* get entry data (add list) */
+	ercd = get_entry_data(priv, &entry_data);
+	if (ercd)
+		return ercd;
+
+	entry_data->entry.req = entry->req;
 	entry_req = &entry_data->entry.req;
 
 	if (entry_req->job_param) {
@@ -321,20 +562,147 @@ static long vspm_ioctl_entry(
 	}
 
 	/* entry job */
-	entry.rsp.ercd = vspm_entry_job(
+	entry->rsp.ercd = vspm_entry_job(
 		priv->handle,
-		&entry.rsp.job_id,
+		&entry->rsp.job_id,
 		entry_req->priority,
 		entry_req->job_param,
 		(void *)entry_data,
 		vspm_cb_func);
 
+	if (entry->rsp.ercd != R_VSPM_OK)
+		goto err_exit;
+
+	return 0;
+
+err_exit:
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_del(&entry_data->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	put_entry_data(entry_data);
+
+	return ercd;
+}
+
+static long vspm_ioctl_entry(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_t entry;
+	int ercd;
+
+	/* copy entry parameter */
+	if (copy_from_user(&entry, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("ENTRY: failed to copy the entry parameter\n");
+		return -EFAULT;
+	}
+
+	/* entry job */
+	ercd = vspm_if_entry(priv, &entry);
+	if (ercd)
+		return ercd;
+
 	/* copy result to user */
 	if (copy_to_user(
 			(void __user *)arg, &entry, _IOC_SIZE(cmd)))
 		APRINT("ENTRY: failed to copy the result\n");
 
-	if (entry.rsp.ercd != R_VSPM_OK)
+	return 0;
+}
+
+static long vspm_ioctl_entry_batch(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_batch_t batch;
+	struct vspm_if_entry_t *entry;
+
+	unsigned int i;
+	int ercd;
+
+	/* copy batch parameter */
+	if (copy_from_user(&batch, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("BATCH: failed to copy the batch parameter\n");
+		return -EFAULT;
+	}
+
+	if (batch.num == 0 || batch.num > VSPM_IF_ENTRY_BATCH_MAX)
+		return -EINVAL;
+
+	/* allocate entry array */
+	entry = kmalloc_array(
+		batch.num, sizeof(struct vspm_if_entry_t), GFP_KERNEL);
+	if (!entry)
+		return -ENOMEM;
+
+	/* copy entry parameters */
+	if (copy_from_user(
+			entry,
+			(void __user *)batch.entry,
+			batch.num * sizeof(struct vspm_if_entry_t))) {
+		EPRINT("BATCH: failed to copy the entry parameter\n");
+		kfree(entry);
+		return -EFAULT;
+	}
+
+	/* entry jobs */
+	for (i = 0; i < batch.num; i++) {
+		ercd = vspm_if_entry(priv, &entry[i]);
+		if (ercd) {
+			/* not entried, positive errno */
+			entry[i].rsp.ercd = -ercd;
+			entry[i].rsp.job_id = 0;
+		}
+	}
+
+	/* copy results to user */
+	if (copy_to_user(
+			(void __user *)batch.entry,
+			entry,
+			batch.num * sizeof(struct vspm_if_entry_t)))
+		APRINT("BATCH: failed to copy the result\n");
+
+	kfree(entry);
+	return 0;
+}
+
+static int vspm_if_entry_flat(
+	struct vspm_if_private_t *priv,
+	struct vspm_if_entry_flat_req_t *req,
+	struct vspm_if_sq_t *sq,
+	struct vspm_if_entry_flat_rsp_t *rsp)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_req_t *entry_req;
+	struct vspm_if_entry_rsp_t entry_rsp;
+
+	unsigned long lock_flag;
+	int ercd = 0;
+
+	/* get entry data (add list) */
+	ercd = get_entry_data(priv, &entry_data);
+	if (ercd)
+		return ercd;
+
+	/* copy job descriptor */
+	ercd = set_flat_par(entry_data, req, sq);
+	if (ercd)
+		goto err_exit;
+
+	entry_req = &entry_data->entry.req;
+
+	/* entry job */
+	entry_rsp.ercd = vspm_entry_job(
+		priv->handle,
+		&entry_rsp.job_id,
+		entry_req->priority,
+		entry_req->job_param,
+		(void *)entry_data,
+		vspm_cb_func);
+
+	rsp->ercd = (int)entry_rsp.ercd;
+	rsp->job_id = entry_rsp.job_id;
+
+	if (entry_rsp.ercd != R_VSPM_OK)
 		goto err_exit;
 
 	return 0;
@@ -344,190 +712,1149 @@ err_exit:
 	list_del(&entry_data->list);
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
 
-	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
-		free_vsp_par(&entry_data->ip_par.vsp);
-	kfree(entry_data);
+	put_entry_data(entry_data);
 
 	return ercd;
 }
 
-static long vspm_ioctl_cancel(
+static long vspm_ioctl_entry_flat(
 	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
 {
-	unsigned long job_id = 0;
+	struct vspm_if_entry_flat_t entry;
+	int ercd;
+
+	/* copy entry parameter */
+	if (copy_from_user(&entry, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("FLAT: failed to copy the entry parameter\n");
+		return -EFAULT;
+	}
+
+	ercd = vspm_if_entry_flat(priv, &entry.req, NULL, &entry.rsp);
+	if (ercd)
+		return ercd;
+
+	/* copy result to user */
+	if (copy_to_user((void __user *)arg, &entry, _IOC_SIZE(cmd)))
+		APRINT("FLAT: failed to copy the result\n");
+
+	return 0;
+}
+
+static long vspm_ioctl_entry_sync(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_req_t *entry_req;
+	struct vspm_if_cb_data_t *cb_data;
+	struct vspm_if_entry_sync_t sync;
+
+	unsigned long job_id;
+	unsigned long lock_flag;
 	long ercd;
 
-	/* copy cancel parameter */
-	if (copy_from_user(&job_id, (void __user *)arg, _IOC_SIZE(cmd))) {
-		EPRINT("CANCEL: failed to copy the request data\n");
+	/* copy entry parameter */
+	if (copy_from_user(&sync, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("SYNC: failed to copy the entry parameter\n");
 		return -EFAULT;
 	}
+	memset(&sync.rsp, 0, sizeof(struct vspm_if_cq_rsp_t));
+
+	/* get entry data (add list) */
+	ercd = get_entry_data(priv, &entry_data);
+	if (ercd)
+		return ercd;
+
+	/* copy job descriptor */
+	ercd = set_flat_par(entry_data, &sync.req, NULL);
+	if (ercd)
+		goto err_exit;
+
+	atomic_set(&entry_data->sync_state, VSPM_IF_SYNC_WAIT);
+	init_completion(&entry_data->sync_done);
+
+	entry_req = &entry_data->entry.req;
+
+	/* entry job */
+	sync.rsp.ercd = (int)vspm_entry_job(
+		priv->handle,
+		&job_id,
+		entry_req->priority,
+		entry_req->job_param,
+		(void *)entry_data,
+		vspm_cb_func);
+	if (sync.rsp.ercd != R_VSPM_OK) {
+		if (copy_to_user((void __user *)arg, &sync, _IOC_SIZE(cmd)))
+			APRINT("SYNC: failed to copy the result\n");
+		goto err_exit;
+	}
+
+	/* wait for the callback of the job */
+	if (wait_for_completion_interruptible(&entry_data->sync_done)) {
+		if (atomic_cmpxchg(
+				&entry_data->sync_state,
+				VSPM_IF_SYNC_WAIT,
+				VSPM_IF_SYNC_ABANDONED) == VSPM_IF_SYNC_WAIT) {
+			/* the callback releases the entry data */
+			return -EINTR;
+		}
+
+		/* the callback is completing the entry */
+		wait_for_completion(&entry_data->sync_done);
+	}
+
+	/* del list */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_del(&entry_data->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	/* HGO/HGT result */
+	cb_data = &entry_data->cb_data;
+	copy_cb_histogram(cb_data);
+
+	sync.rsp.cb_func = (unsigned long)cb_data->rsp.cb_func;
+	sync.rsp.user_data = (unsigned long)cb_data->rsp.user_data;
+	sync.rsp.job_id = cb_data->rsp.job_id;
+	sync.rsp.result = cb_data->rsp.result;
+	sync.rsp.ercd = (int)cb_data->rsp.ercd;
+
+	/* release entry data */
+	put_entry_data(entry_data);
+
+	/* copy result to user */
+	if (copy_to_user((void __user *)arg, &sync, _IOC_SIZE(cmd))) {
+		EPRINT("SYNC: failed to copy the result\n");
+		return -EFAULT;
+	}
+
+	return 0;
+
+err_exit:
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_del(&entry_data->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	put_entry_data(entry_data);
+
+	return ercd;
+}
+
+static long vspm_ioctl_entry_ex(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_req_t *entry_req;
+	struct vspm_if_entry_ex_t entry;
+	struct vspm_if_fence_wait_t *wait = NULL;
+	struct vspm_if_dmabuf_t *import = NULL;
+	struct sync_file *sync_file = NULL;
+
+	int in_fd[VSPM_IF_FENCE_IN_MAX];
+	unsigned long job_id = 0;
+	unsigned long lock_flag;
+	unsigned int i;
+	int fd = -1;
+	long ercd;
+
+	/* copy entry parameter */
+	if (copy_from_user(&entry, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("ENTRY_EX: failed to copy the entry parameter\n");
+		return -EFAULT;
+	}
+
+	if ((entry.flags & ~VSPM_IF_FENCE_OUT) ||
+	    (entry.in_fence_num > VSPM_IF_FENCE_IN_MAX) ||
+	    (entry.dmabuf_num > VSPM_IF_DMABUF_MAX))
+		return -EINVAL;
+
+	entry.fence_fd = -1;
+	memset(&entry.rsp, 0, sizeof(struct vspm_if_entry_flat_rsp_t));
+
+	if (entry.in_fence_num) {
+		/* copy input fences */
+		if (copy_from_user(
+				in_fd,
+				u64_to_user_ptr(entry.in_fence),
+				entry.in_fence_num * sizeof(int))) {
+			EPRINT("ENTRY_EX: failed to copy the input fences\n");
+			return -EFAULT;
+		}
+
+		wait = kzalloc(
+			sizeof(struct vspm_if_fence_wait_t), GFP_KERNEL);
+		if (!wait)
+			return -ENOMEM;
+
+		for (i = 0; i < entry.in_fence_num; i++) {
+			wait->in[i].fence = sync_file_get_fence(in_fd[i]);
+			if (!wait->in[i].fence) {
+				put_fence_wait(wait);
+				return -EINVAL;
+			}
+			wait->in[i].wait = wait;
+			/* QUIT may remove the callback before it is added */
+			INIT_LIST_HEAD(&wait->in[i].cb.node);
+			wait->num++;
+		}
+	}
+
+	if (entry.dmabuf_num) {
+		/* copy dma-buf imports */
+		import = kmalloc_array(
+			entry.dmabuf_num,
+			sizeof(struct vspm_if_dmabuf_t),
+			GFP_KERNEL);
+		if (!import) {
+			ercd = -ENOMEM;
+			goto err_wait;
+		}
+
+		if (copy_from_user(
+				import,
+				u64_to_user_ptr(entry.dmabuf),
+				entry.dmabuf_num *
+				sizeof(struct vspm_if_dmabuf_t))) {
+			EPRINT("ENTRY_EX: failed to copy the dma-buf\n");
+			ercd = -EFAULT;
+			goto err_wait;
+		}
+	}
+
+	/* get entry data (add list) */
+	ercd = get_entry_data(priv, &entry_data);
+	if (ercd)
+		goto err_wait;
+
+	/* copy job descriptor */
+	ercd = set_flat_par(entry_data, &entry.req, NULL);
+	if (ercd)
+		goto err_exit;
+
+	/* set the addresses of dma-buf */
+	for (i = 0; i < entry.dmabuf_num; i++) {
+		ercd = set_dmabuf_par(entry_data, &import[i]);
+		if (ercd)
+			goto err_exit;
+	}
+	kfree(import);
+	import = NULL;
+
+	if (entry.flags & VSPM_IF_FENCE_OUT) {
+		/* create output fence, signaled by the callback */
+		entry_data->out_fence = create_out_fence(priv);
+		if (!entry_data->out_fence) {
+			ercd = -ENOMEM;
+			goto err_exit;
+		}
+
+		sync_file = sync_file_create(entry_data->out_fence);
+		if (!sync_file) {
+			ercd = -ENOMEM;
+			goto err_exit;
+		}
+
+		fd = get_unused_fd_flags(O_CLOEXEC);
+		if (fd < 0) {
+			ercd = fd;
+			goto err_exit;
+		}
+		entry.fence_fd = fd;
+	}
+
+	if (wait) {
+		/* hold the job until the input fences are signaled */
+		wait->entry_data = entry_data;
+		INIT_WORK(&wait->work, vspm_if_fence_work);
+		atomic_set(&wait->pending, 1);
+
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		entry_data->fence_wait = wait;
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		for (i = 0; i < wait->num; i++) {
+			atomic_inc(&wait->pending);
+			if (dma_fence_add_callback(
+					wait->in[i].fence,
+					&wait->in[i].cb,
+					vspm_if_fence_func)) {
+				/* already signaled */
+				if (dma_fence_get_status(wait->in[i].fence) < 0)
+					wait->error = -ECANCELED;
+				atomic_dec(&wait->pending);
+			}
+		}
+
+		/* the job is entried by the worker */
+		if (!atomic_dec_and_test(&wait->pending))
+			goto copy_result;
+
+		/* all of the input fences are signaled */
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		entry_data->fence_wait = NULL;
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		ercd = wait->error;
+		put_fence_wait(wait);
+		wait = NULL;
+		if (ercd) {
+			/* the job ends without entry, as by the worker */
+			entry.rsp.ercd = ECANCELED;
+			vspm_if_finish_entry(entry_data, 0, 0, ECANCELED);
+			goto copy_result;
+		}
+	}
+
+	entry_req = &entry_data->entry.req;
+
+	/* entry job */
+	ercd = vspm_entry_job(
+		priv->handle,
+		&job_id,
+		entry_req->priority,
+		entry_req->job_param,
+		(void *)entry_data,
+		vspm_cb_func);
+
+	entry.rsp.ercd = (int)ercd;
+	entry.rsp.job_id = job_id;
+
+	if (ercd != R_VSPM_OK) {
+		entry.fence_fd = -1;
+		if (copy_to_user((void __user *)arg, &entry, _IOC_SIZE(cmd)))
+			APRINT("ENTRY_EX: failed to copy the result\n");
+		ercd = 0;
+		goto err_exit;
+	}
+
+copy_result:
+	/* copy result to user */
+	if (copy_to_user((void __user *)arg, &entry, _IOC_SIZE(cmd))) {
+		EPRINT("ENTRY_EX: failed to copy the result\n");
+		if (sync_file) {
+			put_unused_fd(fd);
+			fput(sync_file->file);
+		}
+		return -EFAULT;
+	}
+
+	/* publish the fence after the result is copied */
+	if (sync_file)
+		fd_install(fd, sync_file->file);
+
+	return 0;
+
+err_exit:
+	if (fd >= 0)
+		put_unused_fd(fd);
+	if (sync_file)
+		fput(sync_file->file);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_del(&entry_data->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	put_entry_data(entry_data);
+
+err_wait:
+	if (wait)
+		put_fence_wait(wait);
+	kfree(import);
+
+	return ercd;
+}
+
+static long vspm_ioctl_entry_graph(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_graph_t param;
+	struct vspm_if_graph_job_t *job;
+	struct vspm_if_graph_t *graph;
+	struct vspm_if_entry_data_t *entry_data;
+
+	unsigned long lock_flag;
+	unsigned int i;
+	int ercd = 0;
+
+	/* copy graph parameter */
+	if (copy_from_user(&param, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("GRAPH: failed to copy the graph parameter\n");
+		return -EFAULT;
+	}
+
+	if (param.num == 0 || param.num > VSPM_IF_GRAPH_MAX)
+		return -EINVAL;
+
+	/* allocate job array */
+	job = kmalloc_array(
+		param.num, sizeof(struct vspm_if_graph_job_t), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	/* copy job parameters */
+	if (copy_from_user(
+			job,
+			u64_to_user_ptr(param.job),
+			param.num * sizeof(struct vspm_if_graph_job_t))) {
+		EPRINT("GRAPH: failed to copy the job parameter\n");
+		kfree(job);
+		return -EFAULT;
+	}
+
+	/* a job depends on the jobs of lower index only (no cycle) */
+	for (i = 0; i < param.num; i++) {
+		if (job[i].dep & ~(BIT(i) - 1)) {
+			kfree(job);
+			return -EINVAL;
+		}
+	}
+
+	/* allocate graph */
+	graph = kzalloc(sizeof(struct vspm_if_graph_t), GFP_KERNEL);
+	if (!graph) {
+		kfree(job);
+		return -ENOMEM;
+	}
+	graph->priv = priv;
+	spin_lock_init(&graph->lock);
+	INIT_WORK(&graph->work, vspm_if_graph_work);
+	atomic_set(&graph->ref, 1);
+
+	for (i = 0; i < param.num; i++) {
+		/* get entry data (add list) */
+		ercd = get_entry_data(priv, &entry_data);
+		if (ercd)
+			goto err_exit;
+
+		/* the entry data keeps a reference to graph */
+		atomic_inc(&graph->ref);
+		entry_data->graph = graph;
+		entry_data->graph_index = i;
+		graph->entry[i] = entry_data;
+		graph->dep[i] = job[i].dep;
+		graph->num++;
+
+		/* copy job descriptor */
+		ercd = set_flat_par(entry_data, &job[i].req, NULL);
+		if (ercd)
+			goto err_exit;
+	}
+
+	/* entry the jobs without dependency */
+	graph->pending = BIT(graph->num) - 1;
+	vspm_if_run_graph(graph);
+
+	/* copy job IDs to user */
+	spin_lock_irqsave(&graph->lock, lock_flag);
+	for (i = 0; i < graph->num; i++)
+		job[i].job_id = graph->job_id[i];
+	spin_unlock_irqrestore(&graph->lock, lock_flag);
+	put_graph(graph);
+
+	if (copy_to_user(
+			u64_to_user_ptr(param.job),
+			job,
+			param.num * sizeof(struct vspm_if_graph_job_t)))
+		APRINT("GRAPH: failed to copy the job IDs\n");
+
+	kfree(job);
+	return 0;
+
+err_exit:
+	for (i = 0; i < graph->num; i++) {
+		entry_data = graph->entry[i];
+
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		list_del(&entry_data->list);
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		put_entry_data(entry_data);
+	}
+	put_graph(graph);
+	kfree(job);
+
+	return ercd;
+}
+
+static long vspm_ioctl_sq_enter(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_sq_enter_t enter;
+	struct vspm_if_entry_flat_req_t req;
+	struct vspm_if_entry_flat_rsp_t rsp;
+	struct vspm_if_sq_t *sq;
+
+	unsigned int head;
+	unsigned int tail;
+
+	enter.num = 0;
+	enter.ercd = 0;
+
+	down(&priv->sq_sem);
+	sq = priv->sq;
+	if (!sq) {
+		up(&priv->sq_sem);
+		return -ENODEV;
+	}
+
+	head = priv->sq_head;
+	tail = READ_ONCE(sq->tail);
+	if (tail - head > VSPM_IF_SQ_NUM) {
+		up(&priv->sq_sem);
+		return -EINVAL;
+	}
+
+	/* read the records after the tail */
+	smp_rmb();
+
+	while (head != tail) {
+		/* copy the record, user can write the ring */
+		req = sq->req[head % VSPM_IF_SQ_NUM];
+		head++;
+		enter.num++;
+
+		/* entry job */
+		enter.ercd = vspm_if_entry_flat(priv, &req, sq, &rsp);
+		if (!enter.ercd)
+			enter.ercd = rsp.ercd;
+		if (enter.ercd)
+			break;
+	}
+
+	/* release the records */
+	smp_mb();
+	priv->sq_head = head;
+	WRITE_ONCE(sq->head, head);
+	up(&priv->sq_sem);
+
+	/* copy result to user */
+	if (copy_to_user((void __user *)arg, &enter, _IOC_SIZE(cmd))) {
+		EPRINT("SQ_ENTER: failed to copy the result\n");
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static long vspm_ioctl_template_reg(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_template_reg_t reg;
+	struct vspm_if_template_t *tmpl;
+
+	unsigned long lock_flag;
+	int ercd;
+
+	/* copy register parameter */
+	if (copy_from_user(&reg, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("TMPL_REG: failed to copy the parameter\n");
+		return -EFAULT;
+	}
+
+	/* allocate template */
+	tmpl = kzalloc(sizeof(struct vspm_if_template_t), GFP_KERNEL);
+	if (!tmpl)
+		return -ENOMEM;
+
+	tmpl->entry_data =
+		kzalloc(sizeof(struct vspm_if_entry_data_t), GFP_KERNEL);
+	if (!tmpl->entry_data) {
+		kfree(tmpl);
+		return -ENOMEM;
+	}
+	tmpl->entry_data->priv = priv;
+	tmpl->entry_data->tmpl = tmpl;
+
+	/* copy job descriptor (the work buffer stays bound) */
+	ercd = set_flat_par(tmpl->entry_data, &reg.req, NULL);
+	if (ercd) {
+		kfree(tmpl->entry_data);
+		kfree(tmpl);
+		return ercd;
+	}
+
+	/* add list */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	tmpl->handle = ++priv->tmpl_handle;
+	list_add_tail(&tmpl->list, &priv->tmpl_list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	/* copy handle to user */
+	reg.handle = tmpl->handle;
+	if (copy_to_user((void __user *)arg, &reg, _IOC_SIZE(cmd))) {
+		EPRINT("TMPL_REG: failed to copy the handle\n");
+		(void)release_template(priv, reg.handle);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static long vspm_ioctl_template_unreg(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	unsigned int handle;
+
+	/* copy template handle */
+	if (copy_from_user(&handle, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("TMPL_UNREG: failed to copy the handle\n");
+		return -EFAULT;
+	}
+
+	return release_template(priv, handle);
+}
+
+static long vspm_ioctl_template_entry(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_template_entry_t entry;
+	struct vspm_if_template_t *tmpl;
+	struct vspm_if_patch_t patch[VSPM_IF_PATCH_MAX];
+	struct vspm_if_entry_rsp_t entry_rsp;
+
+	unsigned long lock_flag;
+	unsigned int i;
+	int ercd = 0;
+
+	/* copy entry parameter */
+	if (copy_from_user(&entry, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("TMPL_ENTRY: failed to copy the entry parameter\n");
+		return -EFAULT;
+	}
+
+	if (entry.req.patch_num > VSPM_IF_PATCH_MAX)
+		return -EINVAL;
+
+	/* copy patches */
+	if (entry.req.patch_num) {
+		if (copy_from_user(
+				patch,
+				u64_to_user_ptr(entry.req.patch),
+				entry.req.patch_num *
+				sizeof(struct vspm_if_patch_t))) {
+			EPRINT("TMPL_ENTRY: failed to copy the patches\n");
+			return -EFAULT;
+		}
+	}
+
+	/* release the entries posted to completion ring */
+	reclaim_entry_data(priv);
+
+	/* get template */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	tmpl = find_template(priv, entry.req.handle);
+	if (!tmpl) {
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return -ENOENT;
+	}
+	if (tmpl->use_flag) {
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return -EBUSY;
+	}
+	tmpl->use_flag = 1;
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	entry_data = tmpl->entry_data;
+
+	/* apply patches */
+	for (i = 0; i < entry.req.patch_num; i++) {
+		ercd = set_patch_par(entry_data, &patch[i]);
+		if (ercd) {
+			spin_lock_irqsave(&priv->lock, lock_flag);
+			tmpl->use_flag = 0;
+			spin_unlock_irqrestore(&priv->lock, lock_flag);
+			return ercd;
+		}
+	}
+	entry_data->entry.req.user_data =
+		VSPM_IF_INT_TO_VP(entry.req.user_data);
+
+	/* hand over the cached area to the device again */
+	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
+		sync_work_buffer_for_device(entry_data->ip_par.vsp.work_buff);
+
+	/* add list */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_add_tail(&entry_data->list, &priv->entry_data.list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	/* entry job */
+	entry_rsp.ercd = vspm_entry_job(
+		priv->handle,
+		&entry_rsp.job_id,
+		entry_data->entry.req.priority,
+		entry_data->entry.req.job_param,
+		(void *)entry_data,
+		vspm_cb_func);
+
+	/* copy result to user */
+	entry.rsp.ercd = (int)entry_rsp.ercd;
+	entry.rsp.job_id = entry_rsp.job_id;
+	if (copy_to_user((void __user *)arg, &entry, _IOC_SIZE(cmd)))
+		APRINT("TMPL_ENTRY: failed to copy the result\n");
+
+	if (entry_rsp.ercd != R_VSPM_OK) {
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		list_del(&entry_data->list);
+		tmpl->use_flag = 0;
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+	}
+
+	return 0;
+}
+
+static long vspm_ioctl_cancel(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	unsigned long job_id = 0;
+	long ercd;
+
+	/* copy cancel parameter */
+	if (copy_from_user(&job_id, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("CANCEL: failed to copy the request data\n");
+		return -EFAULT;
+	}
+
+	/* cancel job */
+	ercd = vspm_cancel_job(priv->handle, job_id);
+	switch (ercd) {
+	case R_VSPM_OK:
+		break;
+	case VSPM_STATUS_ACTIVE:
+		return -EBUSY;
+	case VSPM_STATUS_NO_ENTRY:
+		return -ENOENT;
+	default:
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static long vspm_ioctl_get_status(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_status_t status;
+	struct fdp_status_t fdp_status;
+
+	long ercd;
+
+	struct vspm_status_t user_status;
+
+	/* copy status parameter from user */
+	if (copy_from_user(&user_status, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("GET: failed to copy from user\n");
+		return -EFAULT;
+	}
+
+	status.fdp = &fdp_status;
+
+	/* get a status */
+	ercd = vspm_get_status(priv->handle, &status);
+	switch (ercd) {
+	case R_VSPM_OK:
+		/* copy status parameter to user */
+		if (copy_to_user(
+				(void __user *)user_status.fdp,
+				&fdp_status,
+				sizeof(struct fdp_status_t))) {
+			EPRINT("GET: failed to copy to user\n");
+			return -EFAULT;
+		}
+		break;
+	case R_VSPM_PARAERR:
+		return -EINVAL;
+	default:
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static unsigned int vspm_if_enter_wait(struct vspm_if_private_t *priv)
+{
+	unsigned long lock_flag;
+	unsigned int stop_gen;
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	stop_gen = priv->stop_gen;
+	priv->waiters++;
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	return stop_gen;
+}
+
+static void vspm_if_leave_wait(struct vspm_if_private_t *priv)
+{
+	unsigned long lock_flag;
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	priv->waiters--;
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+}
+
+static long vspm_if_wait_cb_data(
+	struct vspm_if_private_t *priv,
+	unsigned int f_flags,
+	long timeout,
+	struct vspm_if_cb_data_t **cb_data,
+	long *rsp_ercd)
+{
+	DEFINE_WAIT(wait);
+	unsigned long lock_flag;
+	unsigned int stop_gen;
+	int ready = 0;
+	int notify;
+	int more = 0;
+	int found;
+	long ercd = 0;
+
+	stop_gen = vspm_if_enter_wait(priv);
+
+	*cb_data = NULL;
+	for (;;) {
+		/*
+		 * the wakeup after this point is not lost, and one response
+		 * wakes one receiver.
+		 */
+		prepare_to_wait_exclusive(
+			&priv->wait_poll, &wait, TASK_INTERRUPTIBLE);
+
+		/* get response data */
+		found = 1;
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		collect_cb_data(priv);
+		if (priv->stop_gen != stop_gen) {
+			/* stop request while waiting */
+			*rsp_ercd = -1;
+		} else if (!list_empty(&priv->cb_data.list)) {
+			*cb_data = list_first_entry(
+				&priv->cb_data.list,
+				struct vspm_if_cb_data_t,
+				list);
+			list_del(&(*cb_data)->list);
+			atomic_dec(&priv->cb_num);
+			more = !list_empty(&priv->cb_data.list);
+		} else if (priv->stop_flag) {
+			/* stop request */
+			priv->stop_flag = 0;
+			*rsp_ercd = -1;
+		} else if (!is_cq_empty(priv)) {
+			/* the response is in completion ring */
+			*rsp_ercd = VSPM_IF_ERCD_CQ;
+		} else {
+			found = 0;
+		}
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		if (found)
+			break;
+
+		if (f_flags & O_NONBLOCK) {
+			ercd = -EAGAIN;
+			break;
+		}
+		if (signal_pending(current)) {
+			ercd = -EINTR;
+			break;
+		}
+		if (!timeout) {
+			ercd = -ETIMEDOUT;
+			break;
+		}
+
+		/*
+		 * notify VSPM_IOC_CMD_WAIT_THREAD that the waiter sleeps,
+		 * only once until the next stop request.
+		 */
+		if (!ready) {
+			spin_lock_irqsave(&priv->lock, lock_flag);
+			notify = !priv->thread_ready;
+			priv->thread_ready = 1;
+			spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+			if (notify)
+				complete(&priv->wait_thread);
+			ready = 1;
+		}
+
+		/* wait process end */
+		timeout = schedule_timeout(timeout);
+	}
+	finish_wait(&priv->wait_poll, &wait);
+
+	vspm_if_leave_wait(priv);
+
+	/* pass the wakeup to other receiver */
+	if (more || (ercd && ready))
+		wake_up_interruptible(&priv->wait_poll);
+
+	return ercd;
+}
+
+static long vspm_ioctl_wait_interrupt(
+	struct vspm_if_private_t *priv,
+	unsigned int f_flags,
+	unsigned int cmd,
+	unsigned long arg)
+{
+	struct vspm_if_cb_data_t *cb_data;
+	long rsp_ercd;
+	long ercd = 0;
+
+	/* wait response data */
+	ercd = vspm_if_wait_cb_data(
+		priv, f_flags, MAX_SCHEDULE_TIMEOUT, &cb_data, &rsp_ercd);
+	if (ercd)
+		return ercd;
+
+	if (!cb_data) {
+		struct vspm_if_cb_rsp_t rsp;
+
+		/* set response data (ercd = -1 or VSPM_IF_ERCD_CQ) */
+		memset(&rsp, 0, sizeof(struct vspm_if_cb_rsp_t));
+		rsp.ercd = rsp_ercd;
+
+		/* copy response data to user */
+		if (copy_to_user((void __user *)arg, &rsp, _IOC_SIZE(cmd))) {
+			EPRINT("CB: failed to copy the response\n");
+			return -EFAULT;
+		}
+	} else {
+		/* HGO/HGT result */
+		copy_cb_histogram(cb_data);
+
+		/* copy response data to user */
+		if (copy_to_user(
+				(void __user *)arg,
+				&cb_data->rsp,
+				_IOC_SIZE(cmd))) {
+			EPRINT("CB: failed to copy the response\n");
+			ercd = -EFAULT;
+		}
 
-	/* cancel job */
-	ercd = vspm_cancel_job(priv->handle, job_id);
-	switch (ercd) {
-	case R_VSPM_OK:
-		break;
-	case VSPM_STATUS_ACTIVE:
-		return -EBUSY;
-	case VSPM_STATUS_NO_ENTRY:
-		return -ENOENT;
-	default:
-		return -EFAULT;
+		/* release entry data */
+		put_cb_data(cb_data);
 	}
 
-	return 0;
+	return ercd;
 }
 
-static long vspm_ioctl_get_status(
-	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+static long vspm_ioctl_wait_timeout(
+	struct vspm_if_private_t *priv,
+	unsigned int f_flags,
+	unsigned int cmd,
+	unsigned long arg)
 {
-	struct vspm_status_t status;
-	struct fdp_status_t fdp_status;
-
+	struct vspm_if_wait_t wait;
+	struct vspm_if_cb_data_t *cb_data;
+	unsigned long long now;
+	long rsp_ercd;
+	long timeout;
 	long ercd;
 
-	struct vspm_status_t user_status;
-
-	/* copy status parameter from user */
-	if (copy_from_user(&user_status, (void __user *)arg, _IOC_SIZE(cmd))) {
-		EPRINT("GET: failed to copy from user\n");
+	/* copy wait parameter */
+	if (copy_from_user(&wait, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("WAIT_TIMEOUT: failed to copy the parameter\n");
 		return -EFAULT;
 	}
 
-	status.fdp = &fdp_status;
+	/* convert absolute time to relative time */
+	if (wait.flags & VSPM_IF_WAIT_ABSTIME) {
+		now = ktime_get_ns();
+		if (wait.timeout > now)
+			wait.timeout -= now;
+		else
+			wait.timeout = 0;
+	}
 
-	/* get a status */
-	ercd = vspm_get_status(priv->handle, &status);
-	switch (ercd) {
-	case R_VSPM_OK:
-		/* copy status parameter to user */
-		if (copy_to_user(
-				(void __user *)user_status.fdp,
-				&fdp_status,
-				sizeof(struct fdp_status_t))) {
-			EPRINT("GET: failed to copy to user\n");
-			return -EFAULT;
-		}
-		break;
-	case R_VSPM_PARAERR:
-		return -EINVAL;
-	default:
+	/* nanoseconds to jiffies (round up) */
+	if (wait.timeout == 0)
+		timeout = 0;
+	else if (wait.timeout >=
+		 (unsigned long long)(MAX_SCHEDULE_TIMEOUT - 1) * TICK_NSEC)
+		timeout = MAX_SCHEDULE_TIMEOUT - 1;
+	else
+		timeout = nsecs_to_jiffies(wait.timeout + TICK_NSEC - 1);
+
+	/* wait response data */
+	ercd = vspm_if_wait_cb_data(
+		priv, f_flags, timeout, &cb_data, &rsp_ercd);
+	if (ercd)
+		return ercd;
+
+	memset(&wait.rsp, 0, sizeof(struct vspm_if_cq_rsp_t));
+	if (!cb_data) {
+		/* set response data (ercd = -1 or VSPM_IF_ERCD_CQ) */
+		wait.rsp.ercd = (int)rsp_ercd;
+	} else {
+		/* HGO/HGT result */
+		copy_cb_histogram(cb_data);
+
+		wait.rsp.cb_func = (unsigned long)cb_data->rsp.cb_func;
+		wait.rsp.user_data = (unsigned long)cb_data->rsp.user_data;
+		wait.rsp.job_id = cb_data->rsp.job_id;
+		wait.rsp.result = cb_data->rsp.result;
+		wait.rsp.ercd = (int)cb_data->rsp.ercd;
+
+		/* release entry data */
+		put_cb_data(cb_data);
+	}
+
+	/* copy response data to user */
+	if (copy_to_user((void __user *)arg, &wait, _IOC_SIZE(cmd))) {
+		EPRINT("WAIT_TIMEOUT: failed to copy the response\n");
 		return -EFAULT;
 	}
 
 	return 0;
 }
 
-static long vspm_ioctl_wait_interrupt(
+static int vspm_if_reap_ready(
+	struct vspm_if_private_t *priv, unsigned int min, unsigned int stop_gen)
+{
+	return (atomic_read(&priv->cb_num) >= min) ||
+		(READ_ONCE(priv->stop_gen) != stop_gen);
+}
+
+static long vspm_ioctl_reap(
 	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
 {
+	struct vspm_if_reap_t reap;
+	struct vspm_if_cq_rsp_t rsp;
 	struct vspm_if_cb_data_t *cb_data;
+	struct vspm_if_cb_data_t *next;
+
 	unsigned long lock_flag;
-	long ercd = 0;
+	unsigned long timeout;
+	unsigned int stop_gen;
+	unsigned int num = 0;
+	unsigned int remain;
+	long ret;
+	LIST_HEAD(list);
+
+	/* copy reap parameter */
+	if (copy_from_user(&reap, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("REAP: failed to copy the parameter\n");
+		return -EFAULT;
+	}
 
-	/* get user process information */
-	priv->thread = current;
-	complete(&priv->wait_thread);
+	if (reap.max == 0 || reap.min > reap.max)
+		return -EINVAL;
 
-	/* wait process end */
-	if (wait_for_completion_interruptible(&priv->wait_interrupt))
-		return -EINTR;
+	/* wait for minimum number of responses */
+	if (reap.min) {
+		if (reap.timeout)
+			timeout = usecs_to_jiffies(reap.timeout);
+		else
+			timeout = MAX_SCHEDULE_TIMEOUT;
+
+		stop_gen = vspm_if_enter_wait(priv);
+		ret = wait_event_interruptible_timeout(
+			priv->wait_poll,
+			vspm_if_reap_ready(priv, reap.min, stop_gen),
+			timeout);
+		vspm_if_leave_wait(priv);
+		if (ret < 0)
+			return -EINTR;
+	}
 
 	/* get response data */
 	spin_lock_irqsave(&priv->lock, lock_flag);
-	if (list_empty(&priv->cb_data.list)) {
-		cb_data = NULL;
-	} else {
-		cb_data = list_first_entry(
-			&priv->cb_data.list, struct vspm_if_cb_data_t, list);
-		list_del(&cb_data->list);
+	collect_cb_data(priv);
+	list_for_each_entry_safe(cb_data, next, &priv->cb_data.list, list) {
+		if (num >= reap.max)
+			break;
+		list_move_tail(&cb_data->list, &list);
+		atomic_dec(&priv->cb_num);
+		num++;
 	}
+	remain = atomic_read(&priv->cb_num);
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
 
-	if (!cb_data) {
-		struct vspm_if_cb_rsp_t rsp;
+	/* pass the wakeup on to the other receivers */
+	if (remain)
+		wake_up_interruptible(&priv->wait_poll);
 
-		/* set response data (ercd = -1) */
-		memset(&rsp, 0, sizeof(struct vspm_if_cb_rsp_t));
-		rsp.ercd = -1;
+	/* copy response data to user */
+	reap.num = 0;
+	list_for_each_entry_safe(cb_data, next, &list, list) {
+		memset(&rsp, 0, sizeof(struct vspm_if_cq_rsp_t));
+		rsp.cb_func = (unsigned long)cb_data->rsp.cb_func;
+		rsp.user_data = (unsigned long)cb_data->rsp.user_data;
+		rsp.job_id = cb_data->rsp.job_id;
+		rsp.result = cb_data->rsp.result;
+		rsp.ercd = (int)cb_data->rsp.ercd;
 
-		/* copy response data to user */
-		if (copy_to_user((void __user *)arg, &rsp, _IOC_SIZE(cmd))) {
-			EPRINT("CB: failed to copy the response\n");
-			return -EFAULT;
-		}
-	} else {
-		/* HGO result */
-		if (cb_data->vsp_hgo.virt_addr) {
-			unsigned long tmp_addr =
-				(unsigned long)(cb_data->vsp_hgo.virt_addr);
-			tmp_addr = (tmp_addr + 255) >> 8;
-			/* copy to user area */
-			if (cb_data->vsp_hgo.user_addr) {
-				if (copy_to_user((void __user *)
-						cb_data->vsp_hgo.user_addr,
-						(void *)(tmp_addr << 8),
-						1088)) {
-					APRINT("CB: failed to copy HGO data\n");
-				}
-			}
+		if (copy_to_user(
+				u64_to_user_ptr(
+					reap.rsp + reap.num * sizeof(rsp)),
+				&rsp,
+				sizeof(rsp))) {
+			EPRINT("REAP: failed to copy the response\n");
+			break;
 		}
+		reap.num++;
 
-		/* HGT result */
-		if (cb_data->vsp_hgt.virt_addr) {
-			unsigned long tmp_addr =
-				(unsigned long)(cb_data->vsp_hgt.virt_addr);
-			tmp_addr = (tmp_addr + 255) >> 8;
-			/* copy to user area */
-			if (cb_data->vsp_hgt.user_addr) {
-				if (copy_to_user((void __user *)
-						cb_data->vsp_hgt.user_addr,
-						(void *)(tmp_addr << 8),
-						800)) {
-					APRINT("CB: failed to copy HGT data\n");
-				}
-			}
-		}
+		/* HGO/HGT result */
+		copy_cb_histogram(cb_data);
 
-		/* copy response data to user */
-		if (copy_to_user(
-				(void __user *)arg,
-				&cb_data->rsp,
-				_IOC_SIZE(cmd))) {
-			EPRINT("CB: failed to copy the response\n");
-			ercd = -EFAULT;
-		}
+		/* release entry data */
+		list_del(&cb_data->list);
+		put_cb_data(cb_data);
+	}
 
-		/* release memory */
-		free_cb_vsp_par(cb_data);
-		kfree(cb_data);
+	/* requeue the responses not copied in front of the callback list */
+	if (reap.num < num) {
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		list_splice(&list, &priv->cb_data.list);
+		atomic_add(num - reap.num, &priv->cb_num);
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		wake_up_interruptible(&priv->wait_poll);
+
+		if (reap.num == 0)
+			return -EFAULT;
 	}
 
-	return ercd;
+	/* copy reap parameter to user */
+	if (copy_to_user((void __user *)arg, &reap, _IOC_SIZE(cmd))) {
+		EPRINT("REAP: failed to copy the parameter\n");
+		return -EFAULT;
+	}
+
+	return 0;
 }
 
 static long vspm_ioctl_wait_thread(struct vspm_if_private_t *priv)
 {
-	/* wait for callback thread of user */
+	/* wait for callback thread of user to sleep in WAIT_INTERRUPT */
 	if (wait_for_completion_interruptible(&priv->wait_thread)) {
 		APRINT("CB_START: INTR\n");
 		return -EINTR;
 	}
 
-	/* wait for running state of callback thread  */
-	while ((!priv->thread) || (priv->thread->state == TASK_RUNNING))
-		schedule();
-
 	return 0;
 }
 
 static long vspm_ioctl_stop_thread(struct vspm_if_private_t *priv)
 {
+	unsigned long lock_flag;
+
 	/* release callback data */
 	release_all_cb_data(priv);
 
-	complete(&priv->wait_interrupt);
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	/* stop all receivers, or the next one if no receiver waits */
+	priv->stop_gen++;
+	if (!priv->waiters)
+		priv->stop_flag = 1;
+
+	/* the next receiver is notified to VSPM_IOC_CMD_WAIT_THREAD */
+	priv->thread_ready = 0;
+	reinit_completion(&priv->wait_thread);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	wake_up_interruptible_all(&priv->wait_poll);
 
 	return 0;
 }
@@ -563,7 +1890,8 @@ static long unlocked_ioctl(
 		ercd = vspm_ioctl_get_status(priv, cmd, arg);
 		break;
 	case VSPM_IOC_CMD_WAIT_INTERRUPT:
-		ercd = vspm_ioctl_wait_interrupt(priv, cmd, arg);
+		ercd = vspm_ioctl_wait_interrupt(
+			priv, file->f_flags, cmd, arg);
 		break;
 	case VSPM_IOC_CMD_WAIT_THREAD:
 		ercd = vspm_ioctl_wait_thread(priv);
@@ -571,6 +1899,43 @@ static long unlocked_ioctl(
 	case VSPM_IOC_CMD_STOP_THREAD:
 		ercd = vspm_ioctl_stop_thread(priv);
 		break;
+	case VSPM_IOC_CMD_ENTRY_BATCH:
+		ercd = vspm_ioctl_entry_batch(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_FLAT:
+		ercd = vspm_ioctl_entry_flat(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_REG:
+		ercd = vspm_ioctl_template_reg(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_UNREG:
+		ercd = vspm_ioctl_template_unreg(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_ENTRY:
+		ercd = vspm_ioctl_template_entry(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_CONFIG:
+		ercd = vspm_ioctl_config(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_REAP:
+		ercd = vspm_ioctl_reap(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_SQ_ENTER:
+		ercd = vspm_ioctl_sq_enter(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_SYNC:
+		ercd = vspm_ioctl_entry_sync(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_GRAPH:
+		ercd = vspm_ioctl_entry_graph(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_EX:
+		ercd = vspm_ioctl_entry_ex(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_WAIT_TIMEOUT:
+		ercd = vspm_ioctl_wait_timeout(
+			priv, file->f_flags, cmd, arg);
+		break;
 	default:
 		ercd = -ENOTTY;
 		break;
@@ -643,8 +2008,9 @@ static long vspm_ioctl_init32(
 	return 0;
 }
 
-static long vspm_ioctl_entry32(
-	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+static int vspm_if_entry32(
+	struct vspm_if_private_t *priv,
+	struct vspm_compat_entry_t *compat_entry)
 {
 	/* for 64bit */
 	struct vspm_if_entry_data_t *entry_data;
@@ -652,35 +2018,20 @@ static long vspm_ioctl_entry32(
 	struct vspm_if_entry_rsp_t entry_rsp;
 
 	/* for 32bit */
-	struct vspm_compat_entry_t compat_entry;
 	struct vspm_compat_job_t compat_job;
-	struct vspm_compat_entry_req_t *compat_req = &compat_entry.req;
-	struct vspm_compat_entry_rsp_t *compat_rsp = &compat_entry.rsp;
+	struct vspm_compat_entry_req_t *compat_req = &compat_entry->req;
+	struct vspm_compat_entry_rsp_t *compat_rsp = &compat_entry->rsp;
 
 	unsigned long lock_flag;
 	int ercd = 0;
 
-	/* allocate entry data */
-	entry_data = kzalloc(sizeof(struct vspm_if_entry_data_t), GFP_KERNEL);
-	if (!entry_data)
-		return -ENOMEM;
-	entry_data->priv = priv;
-
-	/* add list */
-	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_add_tail(&entry_data->list, &priv->entry_data.list);
-	spin_unlock_irqrestore(&priv->lock, lock_flag);
+	/* get entry data (add list) */
+	ercd = get_entry_data(priv, &entry_data);
+	if (ercd)
+		return ercd;
 
 	entry_req = &entry_data->entry.req;
 
-	/* copy entry parameter */
-	if (copy_from_user(
-			&compat_entry, (void __user *)arg, _IOC_SIZE(cmd))) {
-		EPRINT("ENTRY32: failed to copy the entry parameter\n");
-		ercd = -EFAULT;
-		goto err_exit;
-	}
-
 	entry_req->priority = compat_req->priority;
 	entry_req->user_data = VSPM_IF_INT_TO_UP(compat_req->user_data);
 	entry_req->cb_func = VSPM_IF_INT_TO_UP(compat_req->cb_func);
@@ -702,7 +2053,7 @@ static long vspm_ioctl_entry32(
 			/* copy start parameter of VSP */
 			if (compat_job.par.vsp) {
 				ercd = set_compat_vsp_par(
-					entry_data, compat_job.par.vsp);
+					entry_data, compat_job.par.vsp, NULL);
 				if (ercd)
 					goto err_exit;
 
@@ -714,7 +2065,7 @@ static long vspm_ioctl_entry32(
 			/* copy start parameter of FDP */
 			if (compat_job.par.fdp) {
 				ercd = set_compat_fdp_par(
-					entry_data, compat_job.par.fdp);
+					entry_data, compat_job.par.fdp, NULL);
 				if (ercd)
 					goto err_exit;
 
@@ -738,13 +2089,9 @@ static long vspm_ioctl_entry32(
 		(void *)entry_data,
 		vspm_cb_func);
 
-	/* copy result to user */
+	/* set result */
 	compat_rsp->ercd = (int)entry_rsp.ercd;
 	compat_rsp->job_id = (unsigned int)entry_rsp.job_id;
-	if (copy_to_user(
-			(void __user *)arg, &compat_entry, _IOC_SIZE(cmd))) {
-		APRINT("ENTRY32: failed to copy the result\n");
-	}
 
 	if (entry_rsp.ercd != R_VSPM_OK)
 		goto err_exit;
@@ -756,13 +2103,100 @@ err_exit:
 	list_del(&entry_data->list);
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
 
-	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
-		free_vsp_par(&entry_data->ip_par.vsp);
-	kfree(entry_data);
+	put_entry_data(entry_data);
 
 	return ercd;
 }
 
+static long vspm_ioctl_entry32(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	struct vspm_compat_entry_t compat_entry;
+	int ercd;
+
+	/* copy entry parameter */
+	if (copy_from_user(
+			&compat_entry, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("ENTRY32: failed to copy the entry parameter\n");
+		return -EFAULT;
+	}
+
+	/* entry job */
+	ercd = vspm_if_entry32(priv, &compat_entry);
+	if (ercd)
+		return ercd;
+
+	/* copy result to user */
+	if (copy_to_user(
+			(void __user *)arg, &compat_entry, _IOC_SIZE(cmd))) {
+		APRINT("ENTRY32: failed to copy the result\n");
+	}
+
+	return 0;
+}
+
+static long vspm_ioctl_entry_batch32(
+	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+{
+	/* for 32bit */
+	struct vspm_compat_entry_batch_t compat_batch;
+	struct vspm_compat_entry_t *compat_entry;
+
+	unsigned long size;
+	unsigned int i;
+	int ercd;
+
+	/* copy batch parameter */
+	if (copy_from_user(
+			&compat_batch, (void __user *)arg, _IOC_SIZE(cmd))) {
+		EPRINT("BATCH32: failed to copy the batch parameter\n");
+		return -EFAULT;
+	}
+
+	if (compat_batch.num == 0 ||
+	    compat_batch.num > VSPM_IF_ENTRY_BATCH_MAX)
+		return -EINVAL;
+
+	/* allocate entry array */
+	compat_entry = kmalloc_array(
+		compat_batch.num,
+		sizeof(struct vspm_compat_entry_t),
+		GFP_KERNEL);
+	if (!compat_entry)
+		return -ENOMEM;
+
+	/* copy entry parameters */
+	size = compat_batch.num * sizeof(struct vspm_compat_entry_t);
+	if (copy_from_user(
+			compat_entry,
+			VSPM_IF_INT_TO_UP(compat_batch.entry),
+			size)) {
+		EPRINT("BATCH32: failed to copy the entry parameter\n");
+		kfree(compat_entry);
+		return -EFAULT;
+	}
+
+	/* entry jobs */
+	for (i = 0; i < compat_batch.num; i++) {
+		ercd = vspm_if_entry32(priv, &compat_entry[i]);
+		if (ercd) {
+			/* not entried, positive errno */
+			compat_entry[i].rsp.ercd = -ercd;
+			compat_entry[i].rsp.job_id = 0;
+		}
+	}
+
+	/* copy results to user */
+	if (copy_to_user(
+			VSPM_IF_INT_TO_UP(compat_batch.entry),
+			compat_entry,
+			size))
+		APRINT("BATCH32: failed to copy the result\n");
+
+	kfree(compat_entry);
+	return 0;
+}
+
 static long vspm_ioctl_get_status32(
 	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
 {
@@ -816,40 +2250,28 @@ static long vspm_ioctl_get_status32(
 }
 
 static long vspm_ioctl_wait_interrupt32(
-	struct vspm_if_private_t *priv, unsigned int cmd, unsigned long arg)
+	struct vspm_if_private_t *priv,
+	unsigned int f_flags,
+	unsigned int cmd,
+	unsigned long arg)
 {
 	struct vspm_if_cb_data_t *cb_data;
-	unsigned long lock_flag;
+	long rsp_ercd;
 	long ercd = 0;
 
 	/* for 32bit */
 	struct vspm_compat_cb_rsp_t compat_rsp;
 
-	/* get user process information */
-	priv->thread = current;
-	complete(&priv->wait_thread);
-
-	/* wait process end */
-	if (wait_for_completion_interruptible(
-			&priv->wait_interrupt)) {
-		return -EINTR;
-	}
-
-	/* get response data */
-	spin_lock_irqsave(&priv->lock, lock_flag);
-	if (list_empty(&priv->cb_data.list)) {
-		cb_data = NULL;
-	} else {
-		cb_data = list_first_entry(
-			&priv->cb_data.list, struct vspm_if_cb_data_t, list);
-		list_del(&cb_data->list);
-	}
-	spin_unlock_irqrestore(&priv->lock, lock_flag);
+	/* wait response data */
+	ercd = vspm_if_wait_cb_data(
+		priv, f_flags, MAX_SCHEDULE_TIMEOUT, &cb_data, &rsp_ercd);
+	if (ercd)
+		return ercd;
 
 	if (!cb_data) {
-		/* set response data (ercd = -1) */
+		/* set response data (ercd = -1 or VSPM_IF_ERCD_CQ) */
 		memset(&compat_rsp, 0, sizeof(struct vspm_compat_cb_rsp_t));
-		compat_rsp.ercd = -1;
+		compat_rsp.ercd = (int)rsp_ercd;
 
 		/* copy response data to user */
 		if (copy_to_user(
@@ -860,39 +2282,8 @@ static long vspm_ioctl_wait_interrupt32(
 			return -EFAULT;
 		}
 	} else {
-		/* HGO result */
-		if (cb_data->vsp_hgo.virt_addr) {
-			unsigned long tmp_addr =
-				(unsigned long)(cb_data->vsp_hgo.virt_addr);
-			tmp_addr = (tmp_addr + 255) >> 8;
-			/* copy to user area */
-			if (cb_data->vsp_hgo.user_addr) {
-				if (copy_to_user((void __user *)
-						cb_data->vsp_hgo.user_addr,
-						(void *)(tmp_addr << 8),
-						1088)) {
-					APRINT(
-						"CB32: failed to copy HGO data\n");
-				}
-			}
-		}
-
-		/* HGT result */
-		if (cb_data->vsp_hgt.virt_addr) {
-			unsigned long tmp_addr =
-				(unsigned long)(cb_data->vsp_hgt.virt_addr);
-			tmp_addr = (tmp_addr + 255) >> 8;
-			/* copy to user area */
-			if (cb_data->vsp_hgt.user_addr) {
-				if (copy_to_user((void __user *)
-						cb_data->vsp_hgt.user_addr,
-						(void *)(tmp_addr << 8),
-						800)) {
-					APRINT(
-						"CB32: failed to copy HGT data\n");
-				}
-			}
-		}
+		/* HGO/HGT result */
+		copy_cb_histogram(cb_data);
 
 		compat_rsp.ercd = (int)cb_data->rsp.ercd;
 		compat_rsp.cb_func = VSPM_IF_UP_TO_INT(cb_data->rsp.cb_func);
@@ -910,9 +2301,8 @@ static long vspm_ioctl_wait_interrupt32(
 			ercd = -EFAULT;
 		}
 
-		/* release memory */
-		free_cb_vsp_par(cb_data);
-		kfree(cb_data);
+		/* release entry data */
+		put_cb_data(cb_data);
 	}
 
 	return ercd;
@@ -948,7 +2338,8 @@ static long compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		ercd = vspm_ioctl_get_status32(priv, cmd, arg);
 		break;
 	case VSPM_IOC_CMD_WAIT_INTERRUPT32:
-		ercd = vspm_ioctl_wait_interrupt32(priv, cmd, arg);
+		ercd = vspm_ioctl_wait_interrupt32(
+			priv, file->f_flags, cmd, arg);
 		break;
 	case VSPM_IOC_CMD_WAIT_THREAD:
 		ercd = vspm_ioctl_wait_thread(priv);
@@ -956,6 +2347,43 @@ static long compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case VSPM_IOC_CMD_STOP_THREAD:
 		ercd = vspm_ioctl_stop_thread(priv);
 		break;
+	case VSPM_IOC_CMD_ENTRY_BATCH32:
+		ercd = vspm_ioctl_entry_batch32(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_FLAT:
+		ercd = vspm_ioctl_entry_flat(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_REG:
+		ercd = vspm_ioctl_template_reg(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_UNREG:
+		ercd = vspm_ioctl_template_unreg(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_TEMPLATE_ENTRY:
+		ercd = vspm_ioctl_template_entry(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_CONFIG:
+		ercd = vspm_ioctl_config(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_REAP:
+		ercd = vspm_ioctl_reap(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_SQ_ENTER:
+		ercd = vspm_ioctl_sq_enter(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_SYNC:
+		ercd = vspm_ioctl_entry_sync(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_GRAPH:
+		ercd = vspm_ioctl_entry_graph(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_ENTRY_EX:
+		ercd = vspm_ioctl_entry_ex(priv, cmd, arg);
+		break;
+	case VSPM_IOC_CMD_WAIT_TIMEOUT:
+		ercd = vspm_ioctl_wait_timeout(
+			priv, file->f_flags, cmd, arg);
+		break;
 	default:
 		ercd = -ENOTTY;
 		break;
@@ -964,12 +2392,59 @@ static long compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ercd;
 }
 
+static __poll_t poll(struct file *file, poll_table *wait)
+{
+	struct vspm_if_private_t *priv =
+		(struct vspm_if_private_t *)file->private_data;
+
+	unsigned long lock_flag;
+	__poll_t mask = 0;
+
+	if (!priv)
+		return EPOLLERR;
+
+	poll_wait(file, &priv->wait_poll, wait);
+
+	/* readable when VSPM_IOC_CMD_WAIT_INTERRUPT does not sleep */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	if (!list_empty(&priv->cb_data.list) ||
+	    !llist_empty(&priv->cb_llist) ||
+	    !is_cq_empty(priv) ||
+	    priv->stop_flag)
+		mask |= EPOLLIN | EPOLLRDNORM;
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	return mask;
+}
+
+static int mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct vspm_if_private_t *priv =
+		(struct vspm_if_private_t *)file->private_data;
+
+	if (!priv)
+		return -EINVAL;
+
+	switch (vma->vm_pgoff << PAGE_SHIFT) {
+	case VSPM_IF_MMAP_CQ:
+		return map_cq(priv, vma);
+	case VSPM_IF_MMAP_SQ:
+		return map_sq(priv, vma);
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
 static const struct file_operations fops = {
 	.owner   = THIS_MODULE,
 	.open    = open,
 	.release = close,
 	.unlocked_ioctl = unlocked_ioctl,
 	.compat_ioctl = compat_ioctl,
+	.poll    = poll,
+	.mmap    = mmap,
 };
 
 static struct miscdevice misc = {
@@ -1018,6 +2493,20 @@ static int vspm_if_init(void)
 		return -ENODEV;
 	}
 
+	/* pool of work buffers shared by all file handles */
+	if (init_work_pool()) {
+		platform_driver_unregister(&vspm_if_driver);
+		return -ENOMEM;
+	}
+
+	/* workqueue to entry the dependent jobs of graph and held jobs */
+	g_vspmif_wq = alloc_workqueue("vspm_if", WQ_HIGHPRI, 0);
+	if (!g_vspmif_wq) {
+		release_work_pool();
+		platform_driver_unregister(&vspm_if_driver);
+		return -ENOMEM;
+	}
+
 	misc_register(&misc);
 
 	return 0;
@@ -1027,6 +2516,11 @@ static void vspm_if_exit(void)
 {
 	misc_deregister(&misc);
 
+	destroy_workqueue(g_vspmif_wq);
+
+	/* release unused work buffers */
+	release_work_pool();
+
 	platform_driver_unregister(&vspm_if_driver);
 }
 
@@ -60,28 +60,220 @@
 #include <linux/fs.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-buf.h>
 
 #include "vspm_public.h"
 #include "vspm_if.h"
 #include "vspm_if_local.h"
 
-void release_all_entry_data(struct vspm_if_private_t *priv)
+/* from 6.2, the _unlocked variants take the dma-buf reservation lock */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 2, 0)
+#define dma_buf_map_attachment_unlocked dma_buf_map_attachment
+#define dma_buf_unmap_attachment_unlocked dma_buf_unmap_attachment
+#endif
+
+/* minimum size of display list in the work buffer of a job */
+static unsigned int dl_size = VSPM_IF_DL_SIZE;
+module_param(dl_size, uint, 0644);
+MODULE_PARM_DESC(dl_size, "Minimum display list size of a job in bytes");
+
+/* high-water marks of work buffers in KiB (0 means no limit) */
+static unsigned int work_max_kb;
+module_param(work_max_kb, uint, 0644);
+MODULE_PARM_DESC(work_max_kb, "Maximum size of all work buffers in KiB");
+
+static unsigned int work_session_kb;
+module_param(work_session_kb, uint, 0644);
+MODULE_PARM_DESC(work_session_kb,
+	"Maximum size of work buffers per file in KiB");
+
+/* interval to release the idle work buffers (0 means no decay) */
+static unsigned int work_decay_ms = 1000;
+module_param(work_decay_ms, uint, 0644);
+MODULE_PARM_DESC(work_decay_ms, "Interval to release idle work buffers in ms");
+
+/* size of the arena in KiB (0 means each buffer is allocated) */
+static unsigned int arena_kb;
+module_param(arena_kb, uint, 0444);
+MODULE_PARM_DESC(arena_kb, "Size of the work buffer arena in KiB");
+
+/* color tables and histogram in cacheable memory */
+static bool work_cached;
+module_param(work_cached, bool, 0444);
+MODULE_PARM_DESC(work_cached, "Color tables and histogram in cached memory");
+
+/* module-wide pool of unused work buffers */
+static struct vspm_if_work_pool_t g_vspmif_pool;
+static struct vspm_if_work_arena_t g_vspmif_arena;
+static DEFINE_PER_CPU(struct vspm_if_work_mag_t, g_vspmif_mag);
+
+static inline int is_entry_slot(
+	struct vspm_if_private_t *priv, struct vspm_if_entry_data_t *entry_data)
+{
+	return (entry_data >= priv->entry_slot) &&
+		(entry_data < priv->entry_slot + priv->slot_num);
+}
+
+int get_entry_data(
+	struct vspm_if_private_t *priv,
+	struct vspm_if_entry_data_t **entry_data)
+{
+	struct vspm_if_entry_data_t *entry;
+	unsigned long lock_flag;
+
+	/* release the entries posted to completion ring */
+	reclaim_entry_data(priv);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	if (priv->entry_slot) {
+		/* get entry slot */
+		if (list_empty(&priv->slot_list)) {
+			spin_unlock_irqrestore(&priv->lock, lock_flag);
+			return -EBUSY;
+		}
+		entry = list_first_entry(
+			&priv->slot_list, struct vspm_if_entry_data_t, list);
+		list_del(&entry->list);
+		priv->slot_used++;
+
+		/*
+		 * clear the common part only, the parameter part is
+		 * overwritten by set_*_par() when it is used.
+		 */
+		entry->tmpl = NULL;
+		entry->graph = NULL;
+		entry->out_fence = NULL;
+		entry->fence_wait = NULL;
+		entry->dmabuf_num = 0;
+		atomic_set(&entry->sync_state, VSPM_IF_SYNC_NONE);
+		memset(&entry->entry, 0, sizeof(struct vspm_if_entry_t));
+		memset(&entry->job, 0, sizeof(struct vspm_job_t));
+		entry->ip_par.vsp.work_buff = NULL;
+	} else {
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+		/* allocate entry data */
+		entry = kzalloc(
+			sizeof(struct vspm_if_entry_data_t), GFP_KERNEL);
+		if (!entry)
+			return -ENOMEM;
+
+		spin_lock_irqsave(&priv->lock, lock_flag);
+	}
+	entry->priv = priv;
+
+	/* add list */
+	list_add_tail(&entry->list, &priv->entry_data.list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	*entry_data = entry;
+	return 0;
+}
+
+void put_entry_data(struct vspm_if_entry_data_t *entry_data)
+{
+	struct vspm_if_private_t *priv = entry_data->priv;
+	unsigned long lock_flag;
+
+	/* the entry data of template is kept */
+	if (entry_data->tmpl) {
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		entry_data->tmpl->use_flag = 0;
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return;
+	}
+
+	/* the job is not executed */
+	if (entry_data->out_fence)
+		signal_out_fence(entry_data, -ECANCELED);
+
+	/* release the reference to graph */
+	if (entry_data->graph) {
+		put_graph(entry_data->graph);
+		entry_data->graph = NULL;
+	}
+
+	/* release the dma-buf mappings (kept in the cache) */
+	while (entry_data->dmabuf_num)
+		atomic_dec(&entry_data->dmabuf[--entry_data->dmabuf_num]->use);
+
+	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
+		free_vsp_par(entry_data->priv, &entry_data->ip_par.vsp);
+
+	if (is_entry_slot(priv, entry_data)) {
+		/* return entry slot */
+		spin_lock_irqsave(&priv->lock, lock_flag);
+		list_add(&entry_data->list, &priv->slot_list);
+		priv->slot_used--;
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return;
+	}
+
+	kfree(entry_data);
+}
+
+void reclaim_entry_data(struct vspm_if_private_t *priv)
 {
 	struct vspm_if_entry_data_t *entry_data;
 	struct vspm_if_entry_data_t *next;
+	struct llist_node *node;
 
 	unsigned long lock_flag;
 
+	node = llist_del_all(&priv->free_llist);
+	if (!node)
+		return;
+
+	/* del list */
 	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_for_each_entry_safe(
-		entry_data, next, &priv->entry_data.list, list) {
+	llist_for_each_entry(entry_data, node, node)
+		list_del(&entry_data->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	llist_for_each_entry_safe(entry_data, next, node, node)
+		put_entry_data(entry_data);
+}
+
+/* caller holds priv->lock */
+void collect_cb_data(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_data_t *next;
+	struct llist_node *node;
+
+	/* the callbacks push in reverse order */
+	node = llist_reverse_order(llist_del_all(&priv->cb_llist));
+
+	/* move from entry list to callback list */
+	llist_for_each_entry_safe(entry_data, next, node, node) {
 		list_del(&entry_data->list);
-		if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
-			free_vsp_par(&entry_data->ip_par.vsp);
-		kfree(entry_data);
+		list_add_tail(&entry_data->cb_data.list, &priv->cb_data.list);
 	}
+}
+
+void release_all_entry_data(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_entry_data_t *next;
+
+	unsigned long lock_flag;
+	LIST_HEAD(list);
+
+	/* the finished entries are released by other lists */
+	reclaim_entry_data(priv);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	collect_cb_data(priv);
+	list_splice_init(&priv->entry_data.list, &list);
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	list_for_each_entry_safe(entry_data, next, &list, list) {
+		list_del(&entry_data->list);
+		put_entry_data(entry_data);
+	}
 }
 
 void release_all_cb_data(struct vspm_if_private_t *priv)
@@ -90,106 +282,1227 @@ void release_all_cb_data(struct vspm_if_private_t *priv)
 	struct vspm_if_cb_data_t *next;
 
 	unsigned long lock_flag;
+	LIST_HEAD(list);
 
 	spin_lock_irqsave(&priv->lock, lock_flag);
-	list_for_each_entry_safe(cb_data, next, &priv->cb_data.list, list) {
+	collect_cb_data(priv);
+	list_splice_init(&priv->cb_data.list, &list);
+	atomic_set(&priv->cb_num, 0);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	list_for_each_entry_safe(cb_data, next, &list, list) {
 		list_del(&cb_data->list);
-		free_cb_vsp_par(cb_data);
-		kfree(cb_data);
+		put_cb_data(cb_data);
+	}
+}
+
+void put_graph(struct vspm_if_graph_t *graph)
+{
+	/* free after the last job and the entry are finished */
+	if (atomic_dec_and_test(&graph->ref))
+		kfree(graph);
+}
+
+/* output fence */
+struct vspm_if_fence_t {
+	struct dma_fence base;
+	spinlock_t lock;	/* the fence can live longer than the file */
+};
+
+static const char *vspm_if_fence_get_driver_name(struct dma_fence *fence)
+{
+	return "vspm_if";
+}
+
+static const char *vspm_if_fence_get_timeline_name(struct dma_fence *fence)
+{
+	return "vspm_if";
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 19, 0)
+static bool vspm_if_fence_enable_signaling(struct dma_fence *fence)
+{
+	/* the fence is always signaled by the callback */
+	return true;
+}
+#endif
+
+static const struct dma_fence_ops vspm_if_fence_ops = {
+	.get_driver_name = vspm_if_fence_get_driver_name,
+	.get_timeline_name = vspm_if_fence_get_timeline_name,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 19, 0)
+	/* optional from 4.19 */
+	.enable_signaling = vspm_if_fence_enable_signaling,
+	.wait = dma_fence_default_wait,
+#endif
+};
+
+struct dma_fence *create_out_fence(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_fence_t *fence;
+
+	fence = kzalloc(sizeof(struct vspm_if_fence_t), GFP_KERNEL);
+	if (!fence)
+		return NULL;
+
+	spin_lock_init(&fence->lock);
+	dma_fence_init(
+		&fence->base,
+		&vspm_if_fence_ops,
+		&fence->lock,
+		priv->fence_context,
+		(unsigned int)atomic_inc_return(&priv->fence_seqno));
+
+	return &fence->base;
+}
+
+void signal_out_fence(struct vspm_if_entry_data_t *entry_data, int error)
+{
+	struct dma_fence *fence = entry_data->out_fence;
+
+	entry_data->out_fence = NULL;
+
+	if (error)
+		dma_fence_set_error(fence, error);
+	dma_fence_signal(fence);
+	dma_fence_put(fence);
+}
+
+void put_fence_wait(struct vspm_if_fence_wait_t *wait)
+{
+	unsigned int i;
+
+	for (i = 0; i < wait->num; i++)
+		dma_fence_put(wait->in[i].fence);
+
+	kfree(wait);
+}
+
+void cancel_fence_waits(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_entry_data_t *entry_data;
+	struct vspm_if_fence_wait_t *wait;
+
+	unsigned long lock_flag;
+	unsigned int i;
+
+	/* release the held jobs, the worker cancels them */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_for_each_entry(entry_data, &priv->entry_data.list, list) {
+		wait = entry_data->fence_wait;
+		if (!wait)
+			continue;
+
+		for (i = 0; i < wait->num; i++) {
+			if (!dma_fence_remove_callback(
+					wait->in[i].fence, &wait->in[i].cb))
+				continue;
+
+			wait->error = -ECANCELED;
+			if (atomic_dec_and_test(&wait->pending))
+				queue_work(g_vspmif_wq, &wait->work);
+		}
 	}
 	spin_unlock_irqrestore(&priv->lock, lock_flag);
 }
 
-struct vspm_if_work_buff_t *get_work_buffer(struct vspm_if_private_t *priv)
+static void free_dmabuf_map(struct vspm_if_dmabuf_map_t *map)
 {
-	struct vspm_if_work_buff_t *cur_buff = NULL;
-	struct vspm_if_work_buff_t *prev_buff = NULL;
+	dma_buf_unmap_attachment_unlocked(
+		map->attach, map->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(map->dmabuf, map->attach);
+	dma_buf_put(map->dmabuf);
+	kfree(map);
+}
 
-	down(&priv->sem);
+static int get_dmabuf_map(
+	struct vspm_if_private_t *priv,
+	int fd,
+	struct vspm_if_dmabuf_map_t **dmabuf_map)
+{
+	struct vspm_if_dmabuf_map_t *map;
+	struct dma_buf *dmabuf;
+	int ercd;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return -EINVAL;
+
+	down(&priv->dmabuf_sem);
 
-	/* search unused work buffer */
-	cur_buff = priv->work_buff;
-	while (cur_buff) {
-		if (cur_buff->use_flag == 0) {
-			/* set work buffer */
-			cur_buff->use_flag = 1;
-			cur_buff->offset = 0;
+	/* find the cached mapping */
+	list_for_each_entry(map, &priv->dmabuf_list, list) {
+		if (map->dmabuf == dmabuf) {
+			list_move(&map->list, &priv->dmabuf_list);
+			atomic_inc(&map->use);
+			up(&priv->dmabuf_sem);
+
+			dma_buf_put(dmabuf);
+			*dmabuf_map = map;
+			return 0;
+		}
+	}
+
+	/* evict the least recently used mapping */
+	if (priv->dmabuf_num >= VSPM_IF_DMABUF_CACHE_MAX) {
+		ercd = -EBUSY;
+		list_for_each_entry_reverse(map, &priv->dmabuf_list, list) {
+			if (!atomic_read(&map->use)) {
+				list_del(&map->list);
+				priv->dmabuf_num--;
+				free_dmabuf_map(map);
+				ercd = 0;
+				break;
+			}
+		}
+		if (ercd)
+			goto err_exit;
+	}
+
+	map = kzalloc(sizeof(struct vspm_if_dmabuf_map_t), GFP_KERNEL);
+	if (!map) {
+		ercd = -ENOMEM;
+		goto err_exit;
+	}
+
+	/* attach and map */
+	map->attach = dma_buf_attach(dmabuf, &g_vspmif_pdev->dev);
+	if (IS_ERR(map->attach)) {
+		EPRINT("failed to attach dma-buf\n");
+		ercd = PTR_ERR(map->attach);
+		goto err_free;
+	}
+
+	map->sgt = dma_buf_map_attachment_unlocked(
+		map->attach, DMA_BIDIRECTIONAL);
+	if (IS_ERR(map->sgt)) {
+		EPRINT("failed to map dma-buf\n");
+		ercd = PTR_ERR(map->sgt);
+		goto err_detach;
+	}
+
+	/* the hardware needs a contiguous buffer */
+	if (map->sgt->nents != 1 ||
+	    sg_dma_len(map->sgt->sgl) < dmabuf->size) {
+		EPRINT("dma-buf is not contiguous\n");
+		ercd = -EINVAL;
+		goto err_unmap;
+	}
+
+	map->dmabuf = dmabuf;
+	map->hard_addr = sg_dma_address(map->sgt->sgl);
+	atomic_set(&map->use, 1);
+
+	list_add(&map->list, &priv->dmabuf_list);
+	priv->dmabuf_num++;
+	up(&priv->dmabuf_sem);
+
+	*dmabuf_map = map;
+	return 0;
+
+err_unmap:
+	dma_buf_unmap_attachment_unlocked(
+		map->attach, map->sgt, DMA_BIDIRECTIONAL);
+err_detach:
+	dma_buf_detach(dmabuf, map->attach);
+err_free:
+	kfree(map);
+err_exit:
+	up(&priv->dmabuf_sem);
+	dma_buf_put(dmabuf);
+	return ercd;
+}
+
+int set_dmabuf_par(
+	struct vspm_if_entry_data_t *entry, struct vspm_if_dmabuf_t *import)
+{
+	struct vspm_if_dmabuf_map_t *map;
+	struct vspm_if_patch_t patch;
+	dma_addr_t hard_addr;
+	int ercd;
+
+	/* address fields only */
+	if (import->target == VSPM_IF_PATCH_FDP_PICID ||
+	    import->target == VSPM_IF_PATCH_FDP_CURRENT_FIELD)
+		return -EINVAL;
+
+	if (entry->dmabuf_num >= VSPM_IF_DMABUF_MAX)
+		return -EINVAL;
+
+	ercd = get_dmabuf_map(entry->priv, import->fd, &map);
+	if (ercd)
+		return ercd;
+
+	/* the address fields are 32bit */
+	hard_addr = map->hard_addr + import->offset;
+	if (import->offset >= map->dmabuf->size ||
+	    hard_addr > 0xffffffffUL) {
+		atomic_dec(&map->use);
+		return -EINVAL;
+	}
+
+	patch.target = import->target;
+	patch.index = import->index;
+	patch.value = (unsigned int)hard_addr;
+
+	ercd = set_patch_par(entry, &patch);
+	if (ercd) {
+		atomic_dec(&map->use);
+		return ercd;
+	}
+
+	/* the entry keeps the mapping until the job ends */
+	entry->dmabuf[entry->dmabuf_num++] = map;
+	return 0;
+}
+
+void release_all_dmabuf_maps(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_dmabuf_map_t *map;
+	struct vspm_if_dmabuf_map_t *next;
+
+	list_for_each_entry_safe(map, next, &priv->dmabuf_list, list) {
+		list_del(&map->list);
+		free_dmabuf_map(map);
+	}
+	priv->dmabuf_num = 0;
+}
+
+struct vspm_if_template_t *find_template(
+	struct vspm_if_private_t *priv, unsigned int handle)
+{
+	struct vspm_if_template_t *tmpl;
+
+	list_for_each_entry(tmpl, &priv->tmpl_list, list) {
+		if (tmpl->handle == handle)
+			return tmpl;
+	}
+
+	return NULL;
+}
+
+static void free_template(struct vspm_if_template_t *tmpl)
+{
+	struct vspm_if_entry_data_t *entry_data = tmpl->entry_data;
+
+	if (entry_data->job.type == VSPM_TYPE_VSP_AUTO)
+		free_vsp_par(entry_data->priv, &entry_data->ip_par.vsp);
+	kfree(entry_data);
+	kfree(tmpl);
+}
+
+int release_template(struct vspm_if_private_t *priv, unsigned int handle)
+{
+	struct vspm_if_template_t *tmpl;
+	unsigned long lock_flag;
+
+	/* the template may be finished by completion ring */
+	reclaim_entry_data(priv);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	tmpl = find_template(priv, handle);
+	if (!tmpl) {
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return -ENOENT;
+	}
+	if (tmpl->use_flag) {
+		spin_unlock_irqrestore(&priv->lock, lock_flag);
+		return -EBUSY;
+	}
+	list_del(&tmpl->list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	free_template(tmpl);
+	return 0;
+}
+
+void release_all_templates(struct vspm_if_private_t *priv)
+{
+	struct vspm_if_template_t *tmpl;
+	struct vspm_if_template_t *next;
+
+	unsigned long lock_flag;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	list_splice_init(&priv->tmpl_list, &list);
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	/* the work buffers are returned out of the lock */
+	list_for_each_entry_safe(tmpl, next, &list, list) {
+		list_del(&tmpl->list);
+		free_template(tmpl);
+	}
+}
+
+int map_cq(struct vspm_if_private_t *priv, struct vm_area_struct *vma)
+{
+	struct vspm_if_cq_t *cq;
+	unsigned long lock_flag;
+
+	if (vma->vm_end - vma->vm_start > PAGE_ALIGN(VSPM_IF_CQ_SIZE))
+		return -EINVAL;
+
+	down(&priv->sem);
+	if (!priv->cq) {
+		/* allocate completion ring */
+		cq = vmalloc_user(VSPM_IF_CQ_SIZE);
+		if (!cq) {
+			EPRINT("failed to allocate completion ring\n");
 			up(&priv->sem);
-			return cur_buff;
+			return -ENOMEM;
 		}
+		cq->num = VSPM_IF_CQ_NUM;
 
-		prev_buff = cur_buff;
-		cur_buff = cur_buff->next_buff;
+		spin_lock_irqsave(&priv->cq_lock, lock_flag);
+		priv->cq = cq;
+		priv->cq_tail = 0;
+		spin_unlock_irqrestore(&priv->cq_lock, lock_flag);
+	}
+	up(&priv->sem);
+
+	return remap_vmalloc_range(vma, priv->cq, 0);
+}
+
+void release_cq(struct vspm_if_private_t *priv)
+{
+	vfree(priv->cq);
+	priv->cq = NULL;
+}
+
+int map_sq(struct vspm_if_private_t *priv, struct vm_area_struct *vma)
+{
+	struct vspm_if_sq_t *sq;
+	int ercd;
+
+	if (vma->vm_end - vma->vm_start > PAGE_ALIGN(VSPM_IF_SQ_SIZE))
+		return -EINVAL;
+
+	down(&priv->sq_sem);
+	if (!priv->sq) {
+		/* allocate submission ring */
+		sq = vmalloc_user(VSPM_IF_SQ_SIZE);
+		if (!sq) {
+			EPRINT("failed to allocate submission ring\n");
+			up(&priv->sq_sem);
+			return -ENOMEM;
+		}
+		sq->num = VSPM_IF_SQ_NUM;
+		sq->data_size = VSPM_IF_SQ_DATA_SIZE;
+
+		priv->sq = sq;
+		priv->sq_head = 0;
+	}
+	ercd = remap_vmalloc_range(vma, priv->sq, 0);
+	up(&priv->sq_sem);
+
+	return ercd;
+}
+
+void release_sq(struct vspm_if_private_t *priv)
+{
+	vfree(priv->sq);
+	priv->sq = NULL;
+}
+
+int post_cq(
+	struct vspm_if_private_t *priv, struct vspm_if_cb_data_t *cb_data)
+{
+	struct vspm_if_cq_t *cq;
+	struct vspm_if_cq_rsp_t *rsp;
+	unsigned long lock_flag;
+
+	/* the histogram result is copied in the user context */
+	if (cb_data->vsp_hgo.virt_addr || cb_data->vsp_hgt.virt_addr)
+		return -EINVAL;
+
+	spin_lock_irqsave(&priv->cq_lock, lock_flag);
+	cq = priv->cq;
+	if (!cq) {
+		spin_unlock_irqrestore(&priv->cq_lock, lock_flag);
+		return -ENODEV;
+	}
+
+	/* the tail of the ring is kept in priv, user can write the ring */
+	if (priv->cq_tail - READ_ONCE(cq->head) >= VSPM_IF_CQ_NUM) {
+		spin_unlock_irqrestore(&priv->cq_lock, lock_flag);
+		return -ENOSPC;
+	}
+
+	rsp = &cq->rsp[priv->cq_tail % VSPM_IF_CQ_NUM];
+	rsp->cb_func = (unsigned long)cb_data->rsp.cb_func;
+	rsp->user_data = (unsigned long)cb_data->rsp.user_data;
+	rsp->job_id = cb_data->rsp.job_id;
+	rsp->result = cb_data->rsp.result;
+	rsp->ercd = (int)cb_data->rsp.ercd;
+	rsp->reserved = 0;
+
+	/* write the record before the tail */
+	smp_wmb();
+	priv->cq_tail++;
+	WRITE_ONCE(cq->tail, priv->cq_tail);
+	spin_unlock_irqrestore(&priv->cq_lock, lock_flag);
+
+	return 0;
+}
+
+int is_cq_empty(struct vspm_if_private_t *priv)
+{
+	if (!priv->cq)
+		return 1;
+
+	return READ_ONCE(priv->cq->head) == READ_ONCE(priv->cq_tail);
+}
+
+static inline int is_arena_buffer(struct vspm_if_work_buff_t *work_buff)
+{
+	return (work_buff >= g_vspmif_arena.buff) &&
+		(work_buff < g_vspmif_arena.buff + g_vspmif_arena.num);
+}
+
+static struct vspm_if_work_buff_t *alloc_arena_buffer(
+	unsigned int size_class)
+{
+	struct vspm_if_work_buff_t *work_buff;
+	unsigned int order;
+	unsigned int bit;
+
+	spin_lock(&g_vspmif_arena.lock);
+
+	/* find the smallest free block */
+	for (order = size_class; order < VSPM_IF_WORK_CLASS_NUM; order++) {
+		bit = find_first_bit(
+			g_vspmif_arena.free_map[order],
+			g_vspmif_arena.num >> order);
+		if (bit < (g_vspmif_arena.num >> order))
+			break;
+	}
+	if (order == VSPM_IF_WORK_CLASS_NUM) {
+		spin_unlock(&g_vspmif_arena.lock);
+		return NULL;
+	}
+	__clear_bit(bit, g_vspmif_arena.free_map[order]);
+
+	/* split the block, and free the upper halves */
+	while (order > size_class) {
+		order--;
+		bit <<= 1;
+		__set_bit(bit + 1, g_vspmif_arena.free_map[order]);
+	}
+	spin_unlock(&g_vspmif_arena.lock);
+
+	work_buff = &g_vspmif_arena.buff[bit << size_class];
+	work_buff->size = VSPM_IF_WORK_MIN_SIZE << size_class;
+	work_buff->size_class = size_class;
+	work_buff->virt_addr = g_vspmif_arena.virt_addr +
+		(bit << size_class) * VSPM_IF_WORK_MIN_SIZE;
+	work_buff->hard_addr = g_vspmif_arena.hard_addr +
+		(bit << size_class) * VSPM_IF_WORK_MIN_SIZE;
+
+	return work_buff;
+}
+
+static void free_arena_buffer(struct vspm_if_work_buff_t *work_buff)
+{
+	unsigned int order = work_buff->size_class;
+	unsigned int bit = (work_buff - g_vspmif_arena.buff) >> order;
+
+	spin_lock(&g_vspmif_arena.lock);
+
+	/* merge the block with its free buddies */
+	while (order < VSPM_IF_WORK_CLASS_NUM - 1 &&
+	       __test_and_clear_bit(bit ^ 1, g_vspmif_arena.free_map[order])) {
+		bit >>= 1;
+		order++;
+	}
+	__set_bit(bit, g_vspmif_arena.free_map[order]);
+
+	spin_unlock(&g_vspmif_arena.lock);
+}
+
+static int init_work_arena(void)
+{
+	unsigned int num;
+	unsigned int order;
+	unsigned int i;
+
+	/* the arena consists of the blocks of the largest size class */
+	num = (arena_kb << 10) /
+		(VSPM_IF_WORK_MIN_SIZE << (VSPM_IF_WORK_CLASS_NUM - 1));
+	num <<= VSPM_IF_WORK_CLASS_NUM - 1;
+	if (!num)
+		return 0;
+
+	g_vspmif_arena.buff = kcalloc(
+		num, sizeof(struct vspm_if_work_buff_t), GFP_KERNEL);
+	if (!g_vspmif_arena.buff)
+		goto err_exit;
+
+	for (order = 0; order < VSPM_IF_WORK_CLASS_NUM; order++) {
+		g_vspmif_arena.free_map[order] =
+			bitmap_zalloc(num >> order, GFP_KERNEL);
+		if (!g_vspmif_arena.free_map[order])
+			goto err_exit;
+	}
+
+	g_vspmif_arena.virt_addr = dma_alloc_coherent(
+		&g_vspmif_pdev->dev,
+		num * VSPM_IF_WORK_MIN_SIZE,
+		&g_vspmif_arena.hard_addr,
+		GFP_KERNEL);
+	if (!g_vspmif_arena.virt_addr) {
+		EPRINT("failed to allocate work buffer arena\n");
+		goto err_exit;
+	}
+
+	/* all blocks of the largest size class are free */
+	order = VSPM_IF_WORK_CLASS_NUM - 1;
+	for (i = 0; i < (num >> order); i++)
+		__set_bit(i, g_vspmif_arena.free_map[order]);
+
+	spin_lock_init(&g_vspmif_arena.lock);
+	g_vspmif_arena.num = num;
+	return 0;
+
+err_exit:
+	for (order = 0; order < VSPM_IF_WORK_CLASS_NUM; order++)
+		bitmap_free(g_vspmif_arena.free_map[order]);
+	kfree(g_vspmif_arena.buff);
+	memset(&g_vspmif_arena, 0, sizeof(g_vspmif_arena));
+	return -ENOMEM;
+}
+
+static void release_work_arena(void)
+{
+	unsigned int order;
+
+	if (!g_vspmif_arena.num)
+		return;
+
+	dma_free_coherent(
+		&g_vspmif_pdev->dev,
+		g_vspmif_arena.num * VSPM_IF_WORK_MIN_SIZE,
+		g_vspmif_arena.virt_addr,
+		g_vspmif_arena.hard_addr);
+
+	for (order = 0; order < VSPM_IF_WORK_CLASS_NUM; order++)
+		bitmap_free(g_vspmif_arena.free_map[order]);
+	kfree(g_vspmif_arena.buff);
+	memset(&g_vspmif_arena, 0, sizeof(g_vspmif_arena));
+}
+
+static int alloc_work_table(struct vspm_if_work_buff_t *work_buff)
+{
+	work_buff->tbl_virt = kmalloc(VSPM_IF_TBL_SIZE, GFP_KERNEL);
+	if (!work_buff->tbl_virt)
+		return -ENOMEM;
+
+	work_buff->tbl_hard = dma_map_single(
+		&g_vspmif_pdev->dev,
+		work_buff->tbl_virt,
+		VSPM_IF_TBL_SIZE,
+		DMA_BIDIRECTIONAL);
+	if (dma_mapping_error(&g_vspmif_pdev->dev, work_buff->tbl_hard)) {
+		kfree(work_buff->tbl_virt);
+		work_buff->tbl_virt = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void free_work_table(struct vspm_if_work_buff_t *work_buff)
+{
+	if (!work_buff->tbl_virt)
+		return;
+
+	dma_unmap_single(
+		&g_vspmif_pdev->dev,
+		work_buff->tbl_hard,
+		VSPM_IF_TBL_SIZE,
+		DMA_BIDIRECTIONAL);
+	kfree(work_buff->tbl_virt);
+	work_buff->tbl_virt = NULL;
+}
+
+static void free_work_buffer(struct vspm_if_work_buff_t *work_buff)
+{
+	atomic_sub(work_buff->size >> 10, &g_vspmif_pool.total_kb);
+	free_work_table(work_buff);
+
+	if (is_arena_buffer(work_buff)) {
+		free_arena_buffer(work_buff);
+		return;
+	}
+
+	dma_free_coherent(
+		&g_vspmif_pdev->dev,
+		work_buff->size,
+		work_buff->virt_addr,
+		work_buff->hard_addr);
+
+	kfree(work_buff);
+}
+
+static unsigned long free_work_pool(
+	unsigned int size_class, unsigned long num)
+{
+	struct vspm_if_work_buff_t *list = NULL;
+	struct vspm_if_work_buff_t *cur_buff;
+
+	unsigned long lock_flag;
+	unsigned long freed = 0;
+
+	/* take unused work buffers from the pool */
+	spin_lock_irqsave(&g_vspmif_pool.lock, lock_flag);
+	while (freed < num && g_vspmif_pool.free_buff[size_class]) {
+		cur_buff = g_vspmif_pool.free_buff[size_class];
+		g_vspmif_pool.free_buff[size_class] = cur_buff->next_buff;
+		g_vspmif_pool.free_num[size_class]--;
+
+		cur_buff->next_buff = list;
+		list = cur_buff;
+		freed++;
+	}
+	if (g_vspmif_pool.free_min[size_class] >
+	    g_vspmif_pool.free_num[size_class])
+		g_vspmif_pool.free_min[size_class] =
+			g_vspmif_pool.free_num[size_class];
+	spin_unlock_irqrestore(&g_vspmif_pool.lock, lock_flag);
+
+	/* release them out of the lock */
+	while (list) {
+		cur_buff = list;
+		list = cur_buff->next_buff;
+		free_work_buffer(cur_buff);
+	}
+
+	return freed;
+}
+
+static void flush_work_mag(void *info)
+{
+	struct vspm_if_work_buff_t *cur_buff;
+	struct vspm_if_work_mag_t *mag;
+	unsigned long lock_flag;
+	unsigned int size_class;
+
+	/* return the cache of this CPU to the pool */
+	spin_lock_irqsave(&g_vspmif_pool.lock, lock_flag);
+	mag = this_cpu_ptr(&g_vspmif_mag);
+	for (size_class = 0;
+	     size_class < VSPM_IF_WORK_CLASS_NUM;
+	     size_class++) {
+		while (mag->num[size_class]) {
+			cur_buff =
+				mag->buff[size_class][--mag->num[size_class]];
+			cur_buff->next_buff =
+				g_vspmif_pool.free_buff[size_class];
+			g_vspmif_pool.free_buff[size_class] = cur_buff;
+			g_vspmif_pool.free_num[size_class]++;
+		}
+	}
+	spin_unlock_irqrestore(&g_vspmif_pool.lock, lock_flag);
+}
+
+static unsigned long vspm_if_count_objects(
+	struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct vspm_if_work_mag_t *mag;
+	unsigned long count = 0;
+	unsigned int size_class;
+	int cpu;
+
+	for (size_class = 0;
+	     size_class < VSPM_IF_WORK_CLASS_NUM;
+	     size_class++) {
+		count += READ_ONCE(g_vspmif_pool.free_num[size_class]);
+
+		/* unused buffers in the cache of each CPU */
+		for_each_possible_cpu(cpu) {
+			mag = per_cpu_ptr(&g_vspmif_mag, cpu);
+			count += READ_ONCE(mag->num[size_class]);
+		}
+	}
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+static unsigned long vspm_if_scan_objects(
+	struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	unsigned int size_class = VSPM_IF_WORK_CLASS_NUM;
+
+	/* the caches of CPUs are released with the pool */
+	on_each_cpu(flush_work_mag, NULL, 1);
+
+	/* release the large buffers first */
+	while (size_class-- > 0 && freed < sc->nr_to_scan)
+		freed += free_work_pool(size_class, sc->nr_to_scan - freed);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker *g_vspmif_shrinker;
+
+static int register_work_shrinker(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+	g_vspmif_shrinker = shrinker_alloc(0, "vspm_if");
+	if (!g_vspmif_shrinker)
+		return -ENOMEM;
+
+	g_vspmif_shrinker->count_objects = vspm_if_count_objects;
+	g_vspmif_shrinker->scan_objects = vspm_if_scan_objects;
+	g_vspmif_shrinker->seeks = DEFAULT_SEEKS;
+	shrinker_register(g_vspmif_shrinker);
+	return 0;
+#else
+	static struct shrinker shrinker = {
+		.count_objects = vspm_if_count_objects,
+		.scan_objects = vspm_if_scan_objects,
+		.seeks = DEFAULT_SEEKS,
+	};
+
+	g_vspmif_shrinker = &shrinker;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 0, 0)
+	return register_shrinker(g_vspmif_shrinker, "vspm_if");
+#else
+	return register_shrinker(g_vspmif_shrinker);
+#endif
+#endif
+}
+
+static void unregister_work_shrinker(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+	shrinker_free(g_vspmif_shrinker);
+#else
+	unregister_shrinker(g_vspmif_shrinker);
+#endif
+}
+
+static void vspm_if_decay_work(struct work_struct *work)
+{
+	unsigned long lock_flag;
+	unsigned int size_class;
+	unsigned int idle;
+	unsigned int remain = 0;
+
+	/*
+	 * the buffers left in the caches of CPUs are released when they
+	 * are not used in the next interval.
+	 */
+	on_each_cpu(flush_work_mag, NULL, 1);
+
+	for (size_class = 0;
+	     size_class < VSPM_IF_WORK_CLASS_NUM;
+	     size_class++) {
+		/* release half of the buffers not used in the interval */
+		idle = READ_ONCE(g_vspmif_pool.free_min[size_class]);
+		free_work_pool(size_class, (idle + 1) / 2);
+
+		spin_lock_irqsave(&g_vspmif_pool.lock, lock_flag);
+		g_vspmif_pool.free_min[size_class] =
+			g_vspmif_pool.free_num[size_class];
+		remain += g_vspmif_pool.free_num[size_class];
+		spin_unlock_irqrestore(&g_vspmif_pool.lock, lock_flag);
+	}
+
+	if (remain && work_decay_ms) {
+		schedule_delayed_work(
+			&g_vspmif_pool.decay,
+			msecs_to_jiffies(work_decay_ms));
+	}
+}
+
+int init_work_pool(void)
+{
+	int ercd;
+
+	spin_lock_init(&g_vspmif_pool.lock);
+	atomic_set(&g_vspmif_pool.total_kb, 0);
+	INIT_DELAYED_WORK(&g_vspmif_pool.decay, vspm_if_decay_work);
+
+	ercd = init_work_arena();
+	if (ercd)
+		return ercd;
+
+	ercd = register_work_shrinker();
+	if (ercd)
+		release_work_arena();
+
+	return ercd;
+}
+
+static int get_size_class(unsigned int size)
+{
+	int size_class;
+
+	/* select the smallest size class */
+	for (size_class = 0;
+	     size_class < VSPM_IF_WORK_CLASS_NUM;
+	     size_class++) {
+		if (size <= (VSPM_IF_WORK_MIN_SIZE << size_class))
+			return size_class;
+	}
+
+	EPRINT("work buffer is too large (%u)\n", size);
+	return -EINVAL;
+}
+
+static int alloc_work_buffer(
+	unsigned int size_class, struct vspm_if_work_buff_t **work_buff)
+{
+	struct vspm_if_work_buff_t *cur_buff;
+	struct vspm_if_work_mag_t *mag;
+	unsigned long lock_flag;
+	unsigned int size_kb = (VSPM_IF_WORK_MIN_SIZE << size_class) >> 10;
+	unsigned int max_kb;
+	unsigned int i;
+
+	/* get unused work buffer from the cache of this CPU */
+	local_irq_save(lock_flag);
+	mag = this_cpu_ptr(&g_vspmif_mag);
+	if (!mag->num[size_class]) {
+		/* refill half of the cache from the pool */
+		spin_lock(&g_vspmif_pool.lock);
+		while (mag->num[size_class] < VSPM_IF_WORK_MAG_SIZE / 2 &&
+		       g_vspmif_pool.free_buff[size_class]) {
+			cur_buff = g_vspmif_pool.free_buff[size_class];
+			g_vspmif_pool.free_buff[size_class] =
+				cur_buff->next_buff;
+			g_vspmif_pool.free_num[size_class]--;
+			mag->buff[size_class][mag->num[size_class]++] =
+				cur_buff;
+		}
+		if (g_vspmif_pool.free_min[size_class] >
+		    g_vspmif_pool.free_num[size_class])
+			g_vspmif_pool.free_min[size_class] =
+				g_vspmif_pool.free_num[size_class];
+		spin_unlock(&g_vspmif_pool.lock);
+	}
+	if (mag->num[size_class]) {
+		*work_buff = mag->buff[size_class][--mag->num[size_class]];
+		local_irq_restore(lock_flag);
+		return 0;
+	}
+	local_irq_restore(lock_flag);
+
+	/* high-water mark of the module */
+	max_kb = READ_ONCE(work_max_kb);
+	if (max_kb &&
+	    atomic_add_return(size_kb, &g_vspmif_pool.total_kb) > max_kb) {
+		atomic_sub(size_kb, &g_vspmif_pool.total_kb);
+
+		/* release unused buffers of the other size classes */
+		for (i = 0; i < VSPM_IF_WORK_CLASS_NUM; i++)
+			free_work_pool(i, ULONG_MAX);
+
+		if (atomic_add_return(size_kb, &g_vspmif_pool.total_kb) >
+		    max_kb) {
+			atomic_sub(size_kb, &g_vspmif_pool.total_kb);
+			return -ENOMEM;
+		}
+	} else if (!max_kb) {
+		atomic_add(size_kb, &g_vspmif_pool.total_kb);
+	}
+
+	if (g_vspmif_arena.num) {
+		/* carve work buffer from the arena */
+		cur_buff = alloc_arena_buffer(size_class);
+		if (!cur_buff) {
+			/* merge unused buffers, and retry */
+			for (i = 0; i < VSPM_IF_WORK_CLASS_NUM; i++)
+				free_work_pool(i, ULONG_MAX);
+			cur_buff = alloc_arena_buffer(size_class);
+		}
+		if (!cur_buff) {
+			atomic_sub(size_kb, &g_vspmif_pool.total_kb);
+			return -ENOMEM;
+		}
+
+		if (work_cached && alloc_work_table(cur_buff)) {
+			EPRINT("failed to allocate work table\n");
+			free_work_buffer(cur_buff);
+			return -ENOMEM;
+		}
+
+		*work_buff = cur_buff;
+		return 0;
 	}
 
 	/* allocate work buffer */
 	cur_buff = kzalloc(sizeof(struct vspm_if_work_buff_t), GFP_KERNEL);
 	if (!cur_buff) {
 		EPRINT("failed to allocate memory\n");
-		up(&priv->sem);
-		return NULL;
+		atomic_sub(size_kb, &g_vspmif_pool.total_kb);
+		return -ENOMEM;
 	}
 
+	cur_buff->size = VSPM_IF_WORK_MIN_SIZE << size_class;
+	cur_buff->size_class = size_class;
 	cur_buff->virt_addr = dma_alloc_coherent(
 		&g_vspmif_pdev->dev,
-		VSPM_IF_MEM_SIZE,
+		cur_buff->size,
 		&cur_buff->hard_addr,
 		GFP_KERNEL);
 	if (!cur_buff->virt_addr) {
 		EPRINT("failed to allocate work buffer\n");
+		atomic_sub(size_kb, &g_vspmif_pool.total_kb);
 		kfree(cur_buff);
-		up(&priv->sem);
-		return NULL;
+		return -ENOMEM;
+	}
+
+	if (work_cached && alloc_work_table(cur_buff)) {
+		EPRINT("failed to allocate work table\n");
+		free_work_buffer(cur_buff);
+		return -ENOMEM;
 	}
 
-	/* connect work buffer */
-	if (!prev_buff)
-		priv->work_buff = cur_buff;
-	else
-		prev_buff->next_buff = cur_buff;
+	*work_buff = cur_buff;
+	return 0;
+}
+
+static void return_work_buffer(struct vspm_if_work_buff_t *work_buff)
+{
+	struct vspm_if_work_buff_t *cur_buff;
+	struct vspm_if_work_mag_t *mag;
+	unsigned long lock_flag;
+	unsigned int size_class = work_buff->size_class;
+
+	/* return work buffer to the cache of this CPU */
+	local_irq_save(lock_flag);
+	mag = this_cpu_ptr(&g_vspmif_mag);
+	if (mag->num[size_class] == VSPM_IF_WORK_MAG_SIZE) {
+		/* return half of the cache to the pool */
+		spin_lock(&g_vspmif_pool.lock);
+		while (mag->num[size_class] > VSPM_IF_WORK_MAG_SIZE / 2) {
+			cur_buff =
+				mag->buff[size_class][--mag->num[size_class]];
+			cur_buff->next_buff =
+				g_vspmif_pool.free_buff[size_class];
+			g_vspmif_pool.free_buff[size_class] = cur_buff;
+			g_vspmif_pool.free_num[size_class]++;
+		}
+		spin_unlock(&g_vspmif_pool.lock);
+	}
+	mag->buff[size_class][mag->num[size_class]++] = work_buff;
+	local_irq_restore(lock_flag);
+
+	/* release the idle buffers later (no-op while it is pending) */
+	if (work_decay_ms) {
+		schedule_delayed_work(
+			&g_vspmif_pool.decay,
+			msecs_to_jiffies(work_decay_ms));
+	}
+}
+
+int get_work_buffer(
+	struct vspm_if_private_t *priv,
+	unsigned int size,
+	struct vspm_if_work_buff_t **work_buff)
+{
+	struct vspm_if_work_buff_t *cur_buff = NULL;
+	unsigned long lock_flag;
+	unsigned int size_kb;
+	unsigned int max_kb;
+	int size_class;
+	int ercd;
+
+	size_class = get_size_class(size);
+	if (size_class < 0)
+		return size_class;
+
+	/* get work buffer reserved for the file handle */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	if (priv->rsv_buff && size_class <= priv->rsv_class) {
+		cur_buff = priv->rsv_buff;
+		priv->rsv_buff = cur_buff->next_buff;
+		priv->rsv_num--;
+	}
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	if (!cur_buff) {
+		/* high-water mark of the file handle */
+		size_kb = (VSPM_IF_WORK_MIN_SIZE << size_class) >> 10;
+		max_kb = READ_ONCE(work_session_kb);
+		if (max_kb && atomic_read(&priv->work_kb) + size_kb > max_kb)
+			return -EBUSY;
+
+		ercd = alloc_work_buffer(size_class, &cur_buff);
+		if (ercd)
+			return ercd;
+	}
 
 	/* set work buffer */
+	atomic_add(cur_buff->size >> 10, &priv->work_kb);
 	cur_buff->use_flag = 1;
 	cur_buff->offset = 0;
-	up(&priv->sem);
+	cur_buff->tbl_offset = 0;
 
-	return cur_buff;
+	*work_buff = cur_buff;
+	return 0;
 }
 
-void release_work_buffers(struct vspm_if_private_t *priv)
+void put_work_buffer(
+	struct vspm_if_private_t *priv, struct vspm_if_work_buff_t *work_buff)
 {
-	struct vspm_if_work_buff_t *cur_buff;
-	struct vspm_if_work_buff_t *next_buff;
+	unsigned long lock_flag;
 
-	down(&priv->sem);
+	atomic_sub(work_buff->size >> 10, &priv->work_kb);
+	work_buff->use_flag = 0;
 
-	cur_buff = priv->work_buff;
-	while (cur_buff) {
-		next_buff = cur_buff->next_buff;
+	/* refill the work buffers reserved for the file handle */
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	if (work_buff->size_class == priv->rsv_class &&
+	    priv->rsv_num < priv->rsv_max) {
+		work_buff->next_buff = priv->rsv_buff;
+		priv->rsv_buff = work_buff;
+		priv->rsv_num++;
+		work_buff = NULL;
+	}
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	if (work_buff)
+		return_work_buffer(work_buff);
+}
 
-		/* release work buffer */
-		dma_free_coherent(
+void sync_work_buffer_for_device(struct vspm_if_work_buff_t *work_buff)
+{
+	/* write back color tables, and drop the lines of histogram */
+	if (work_buff && work_buff->tbl_offset) {
+		dma_sync_single_for_device(
 			&g_vspmif_pdev->dev,
-			VSPM_IF_MEM_SIZE,
-			cur_buff->virt_addr,
-			cur_buff->hard_addr);
+			work_buff->tbl_hard,
+			work_buff->tbl_offset,
+			DMA_BIDIRECTIONAL);
+	}
+}
 
-		kfree(cur_buff);
+static void sync_work_buffer_for_cpu(struct vspm_if_work_buff_t *work_buff)
+{
+	/* the histogram is written by the device */
+	if (work_buff && work_buff->tbl_offset) {
+		dma_sync_single_for_cpu(
+			&g_vspmif_pdev->dev,
+			work_buff->tbl_hard,
+			work_buff->tbl_offset,
+			DMA_BIDIRECTIONAL);
+	}
+}
 
-		cur_buff = next_buff;
+int set_entry_depth(
+	struct vspm_if_private_t *priv, unsigned int num, unsigned int size)
+{
+	struct vspm_if_entry_data_t *new_slot = NULL;
+	struct vspm_if_entry_data_t *old_slot;
+	struct vspm_if_work_buff_t *list = NULL;
+	struct vspm_if_work_buff_t *cur_buff;
+
+	unsigned long lock_flag;
+	unsigned int i;
+	int size_class = 0;
+	int ercd = 0;
+
+	if (num) {
+		/* footprint of the job without color table and histogram */
+		if (!size)
+			size = ALIGN(READ_ONCE(dl_size), VSPM_IF_WORK_ALIGN);
+
+		size_class = get_size_class(size);
+		if (size_class < 0)
+			return size_class;
+
+		/* allocate entry slots */
+		new_slot = vzalloc(num * sizeof(struct vspm_if_entry_data_t));
+		if (!new_slot)
+			return -ENOMEM;
+
+		/* allocate work buffers in advance */
+		for (i = 0; i < num; i++) {
+			ercd = alloc_work_buffer(size_class, &cur_buff);
+			if (ercd)
+				break;
+			cur_buff->next_buff = list;
+			list = cur_buff;
+		}
 	}
-	priv->work_buff = NULL;
-	up(&priv->sem);
+
+	spin_lock_irqsave(&priv->lock, lock_flag);
+	if (!ercd && priv->slot_used)
+		ercd = -EBUSY;
+	if (!ercd) {
+		/* replace entry slots */
+		old_slot = priv->entry_slot;
+		priv->entry_slot = new_slot;
+		priv->slot_num = num;
+
+		INIT_LIST_HEAD(&priv->slot_list);
+		for (i = 0; i < num; i++)
+			list_add_tail(&new_slot[i].list, &priv->slot_list);
+		new_slot = old_slot;
+
+		/* replace reserved work buffers */
+		cur_buff = list;
+		list = priv->rsv_buff;
+		priv->rsv_buff = cur_buff;
+		priv->rsv_num = num;
+		priv->rsv_max = num;
+		priv->rsv_class = size_class;
+	}
+	spin_unlock_irqrestore(&priv->lock, lock_flag);
+
+	/* release the old (or failed) slots and buffers */
+	vfree(new_slot);
+	while (list) {
+		cur_buff = list;
+		list = cur_buff->next_buff;
+		return_work_buffer(cur_buff);
+	}
+
+	return ercd;
+}
+
+void release_work_pool(void)
+{
+	struct vspm_if_work_mag_t *mag;
+	unsigned int size_class;
+	int cpu;
+
+	unregister_work_shrinker();
+	cancel_delayed_work_sync(&g_vspmif_pool.decay);
+
+	/* all file handles are closed */
+	for_each_possible_cpu(cpu) {
+		mag = per_cpu_ptr(&g_vspmif_mag, cpu);
+		for (size_class = 0;
+		     size_class < VSPM_IF_WORK_CLASS_NUM;
+		     size_class++) {
+			while (mag->num[size_class])
+				free_work_buffer(mag->buff[size_class]
+					[--mag->num[size_class]]);
+		}
+	}
+
+	for (size_class = 0;
+	     size_class < VSPM_IF_WORK_CLASS_NUM;
+	     size_class++) {
+		free_work_pool(size_class, ULONG_MAX);
+	}
+
+	release_work_arena();
 }
 
 static int set_vsp_src_clut_par(
 	struct vsp_dl_t *clut,
-	struct vsp_dl_t *src,
-	struct vspm_if_work_buff_t *work_buff)
+	struct vsp_dl_t *src)
 {
-	unsigned long tmp_addr;
-
-	/* copy vsp_dl_t parameter */
+	/*
+	 * copy vsp_dl_t parameter, the color table is copied to the work
+	 * buffer by set_vsp_work_buff().
+	 */
 	if (copy_from_user(
 			clut,
 			(void __user *)src,
@@ -198,33 +1511,6 @@ static int set_vsp_src_clut_par(
 		return -EFAULT;
 	}
 
-	if (clut->virt_addr &&
-	    clut->tbl_num > 0 &&
-	    clut->tbl_num <= 256) {
-		tmp_addr =
-			(unsigned long)work_buff->virt_addr +
-			(unsigned long)work_buff->offset;
-
-		/* copy color table */
-		if (copy_from_user(
-				(void *)tmp_addr,
-				(void __user *)clut->virt_addr,
-				clut->tbl_num * 8)) {
-			EPRINT("failed to copy of color table\n");
-			return -EFAULT;
-		}
-
-		/* set parameter */
-		clut->virt_addr = (void *)tmp_addr;
-		tmp_addr =
-			(unsigned long)work_buff->hard_addr +
-			(unsigned long)work_buff->offset;
-		clut->hard_addr = (unsigned int)tmp_addr;
-
-		/* increment memory offset */
-		work_buff->offset += VSPM_IF_RPF_CLUT_SIZE;
-	}
-
 	return 0;
 }
 
@@ -281,8 +1567,7 @@ static int set_vsp_src_alpha_par(
 
 static int set_vsp_src_par(
 	struct vspm_entry_vsp_in *in,
-	struct vsp_src_t *src,
-	struct vspm_if_work_buff_t *work_buff)
+	struct vsp_src_t *src)
 {
 	int ercd;
 
@@ -297,7 +1582,7 @@ static int set_vsp_src_par(
 
 	/* copy vsp_dl_t parameter */
 	if (in->in.clut) {
-		ercd = set_vsp_src_clut_par(&in->clut, in->in.clut, work_buff);
+		ercd = set_vsp_src_clut_par(&in->clut, in->in.clut);
 		if (ercd)
 			return ercd;
 		in->in.clut = &in->clut;
@@ -420,11 +1705,8 @@ static int set_vsp_bru_par(
 
 static int set_vsp_hgo_par(
 	struct vspm_entry_vsp_hgo *hgo,
-	struct vsp_hgo_t *src,
-	struct vspm_if_work_buff_t *work_buff)
+	struct vsp_hgo_t *src)
 {
-	unsigned long tmp_addr;
-
 	/* copy vsp_hgo_t parameter */
 	if (copy_from_user(
 			&hgo->hgo,
@@ -435,29 +1717,17 @@ static int set_vsp_hgo_par(
 	}
 	hgo->user_addr = hgo->hgo.virt_addr;
 
-	/* set parameter */
-	tmp_addr =
-		(unsigned long)work_buff->hard_addr +
-		(unsigned long)work_buff->offset;
-	hgo->hgo.hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)work_buff->virt_addr +
-		(unsigned long)work_buff->offset;
-	hgo->hgo.virt_addr = (void *)tmp_addr;
-
-	/* increment memory offset */
-	work_buff->offset += VSPM_IF_HGO_SIZE;
+	/* the result area is assigned by set_vsp_work_buff() */
+	hgo->hgo.hard_addr = 0;
+	hgo->hgo.virt_addr = NULL;
 
 	return 0;
 }
 
 static int set_vsp_hgt_par(
 	struct vspm_entry_vsp_hgt *hgt,
-	struct vsp_hgt_t *src,
-	struct vspm_if_work_buff_t *work_buff)
+	struct vsp_hgt_t *src)
 {
-	unsigned long tmp_addr;
-
 	/* copy vsp_hgt_t parameter */
 	if (copy_from_user(
 			&hgt->hgt,
@@ -468,26 +1738,16 @@ static int set_vsp_hgt_par(
 	}
 	hgt->user_addr = hgt->hgt.virt_addr;
 
-	/* set parameter */
-	tmp_addr =
-		(unsigned long)work_buff->hard_addr +
-		(unsigned long)work_buff->offset;
-	hgt->hgt.hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)work_buff->virt_addr +
-		(unsigned long)work_buff->offset;
-	hgt->hgt.virt_addr = (void *)tmp_addr;
-
-	/* increment memory offset */
-	work_buff->offset += VSPM_IF_HGT_SIZE;
+	/* the result area is assigned by set_vsp_work_buff() */
+	hgt->hgt.hard_addr = 0;
+	hgt->hgt.virt_addr = NULL;
 
 	return 0;
 }
 
 static int set_vsp_ctrl_par(
 	struct vspm_entry_vsp_ctrl *ctrl,
-	struct vsp_ctrl_t *src,
-	struct vspm_if_work_buff_t *work_buff)
+	struct vsp_ctrl_t *src)
 {
 	int ercd;
 
@@ -582,7 +1842,7 @@ static int set_vsp_ctrl_par(
 
 	/* copy vsp_hgo_t parameter */
 	if (ctrl->ctrl.hgo) {
-		ercd = set_vsp_hgo_par(&ctrl->hgo, ctrl->ctrl.hgo, work_buff);
+		ercd = set_vsp_hgo_par(&ctrl->hgo, ctrl->ctrl.hgo);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hgo = &ctrl->hgo.hgo;
@@ -590,7 +1850,7 @@ static int set_vsp_ctrl_par(
 
 	/* copy vsp_hgt_t parameter */
 	if (ctrl->ctrl.hgt) {
-		ercd = set_vsp_hgt_par(&ctrl->hgt, ctrl->ctrl.hgt, work_buff);
+		ercd = set_vsp_hgt_par(&ctrl->hgt, ctrl->ctrl.hgt);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hgt = &ctrl->hgt.hgt;
@@ -611,10 +1871,166 @@ static int set_vsp_ctrl_par(
 	return 0;
 }
 
-int free_vsp_par(struct vspm_entry_vsp *vsp)
+static int copy_from_compat(
+	void *dst,
+	const struct vspm_if_flat_t *flat,
+	unsigned int src,
+	unsigned long size)
+{
+	/* copy from user space */
+	if (!flat) {
+		if (copy_from_user(dst, VSPM_IF_INT_TO_UP(src), size))
+			return -EFAULT;
+		return 0;
+	}
+
+	/* copy from flat descriptor (src is offset in the descriptor) */
+	if (src >= flat->size || size > flat->size - src)
+		return -EFAULT;
+
+	memcpy(dst, flat->buff + src, size);
+	return 0;
+}
+
+static inline int is_vsp_clut(struct vspm_entry_vsp *vsp, int i)
+{
+	struct vsp_dl_t *clut = &vsp->in[i].clut;
+
+	return vsp->par.src_par[i] &&
+		vsp->in[i].in.clut == clut &&
+		clut->virt_addr &&
+		clut->tbl_num > 0 &&
+		clut->tbl_num <= 256;
+}
+
+static void *get_work_area(
+	struct vspm_if_work_buff_t *work_buff,
+	unsigned int size,
+	unsigned int *hard_addr)
+{
+	unsigned long tmp_addr;
+
+	tmp_addr =
+		(unsigned long)work_buff->hard_addr +
+		(unsigned long)work_buff->offset;
+	*hard_addr = (unsigned int)tmp_addr;
+	tmp_addr =
+		(unsigned long)work_buff->virt_addr +
+		(unsigned long)work_buff->offset;
+
+	/* increment memory offset */
+	work_buff->offset += ALIGN(size, VSPM_IF_WORK_ALIGN);
+
+	return (void *)tmp_addr;
+}
+
+static void *get_table_area(
+	struct vspm_if_work_buff_t *work_buff,
+	unsigned int size,
+	unsigned int *hard_addr)
+{
+	void *virt_addr;
+
+	if (!work_buff->tbl_virt)
+		return get_work_area(work_buff, size, hard_addr);
+
+	*hard_addr = (unsigned int)(work_buff->tbl_hard +
+		work_buff->tbl_offset);
+	virt_addr = work_buff->tbl_virt + work_buff->tbl_offset;
+
+	/* increment memory offset */
+	work_buff->tbl_offset += ALIGN(size, VSPM_IF_WORK_ALIGN);
+
+	return virt_addr;
+}
+
+static int set_vsp_work_buff(
+	struct vspm_if_private_t *priv,
+	struct vspm_entry_vsp *vsp,
+	const struct vspm_if_flat_t *flat,
+	int compat)
+{
+	struct vspm_if_work_buff_t *work_buff;
+	struct vsp_ctrl_t *ctrl = vsp->par.ctrl_par;
+	struct vsp_dl_t *clut;
+	struct vsp_dl_t *dl_par = &vsp->par.dl_par;
+
+	unsigned int size = 0;
+	void *virt_addr;
+	int ercd;
+	int i;
+
+	/* footprint of the job (tables are in the cached area) */
+	for (i = 0; i < 5 && !work_cached; i++) {
+		if (is_vsp_clut(vsp, i))
+			size += ALIGN(
+				vsp->in[i].clut.tbl_num * 8,
+				VSPM_IF_WORK_ALIGN);
+	}
+	if (ctrl && ctrl->hgo && !work_cached)
+		size += ALIGN(VSPM_IF_HGO_SIZE, VSPM_IF_WORK_ALIGN);
+	if (ctrl && ctrl->hgt && !work_cached)
+		size += ALIGN(VSPM_IF_HGT_SIZE, VSPM_IF_WORK_ALIGN);
+	size += ALIGN(READ_ONCE(dl_size), VSPM_IF_WORK_ALIGN);
+
+	/* get work buffer */
+	ercd = get_work_buffer(priv, size, &work_buff);
+	if (ercd)
+		return ercd;
+	vsp->work_buff = work_buff;
+
+	/* copy color tables */
+	for (i = 0; i < 5; i++) {
+		if (!is_vsp_clut(vsp, i))
+			continue;
+
+		clut = &vsp->in[i].clut;
+		virt_addr = get_table_area(
+			work_buff, clut->tbl_num * 8, &clut->hard_addr);
+
+		if (compat) {
+			ercd = copy_from_compat(
+				virt_addr,
+				flat,
+				VSPM_IF_UP_TO_INT(clut->virt_addr),
+				clut->tbl_num * 8);
+		} else {
+			ercd = copy_from_user(
+				virt_addr,
+				(void __user *)clut->virt_addr,
+				clut->tbl_num * 8) ? -EFAULT : 0;
+		}
+		if (ercd) {
+			EPRINT("failed to copy of color table\n");
+			return -EFAULT;
+		}
+		clut->virt_addr = virt_addr;
+	}
+
+	/* assign memory for histogram */
+	if (ctrl && ctrl->hgo) {
+		ctrl->hgo->virt_addr = get_table_area(
+			work_buff, VSPM_IF_HGO_SIZE, &ctrl->hgo->hard_addr);
+	}
+	if (ctrl && ctrl->hgt) {
+		ctrl->hgt->virt_addr = get_table_area(
+			work_buff, VSPM_IF_HGT_SIZE, &ctrl->hgt->hard_addr);
+	}
+	sync_work_buffer_for_device(work_buff);
+
+	/* assign the rest of the buffer for display list */
+	dl_par->virt_addr = get_work_area(work_buff, 0, &dl_par->hard_addr);
+	dl_par->tbl_num = (work_buff->size - work_buff->offset) >> 3;
+
+	return 0;
+}
+
+int free_vsp_par(
+	struct vspm_if_private_t *priv, struct vspm_entry_vsp *vsp)
 {
 	if (vsp->work_buff)
-		vsp->work_buff->use_flag = 0;
+		put_work_buffer(priv, vsp->work_buff);
+	vsp->work_buff = NULL;
 
 	return 0;
 }
@@ -624,9 +2040,6 @@ int set_vsp_par(
 {
 	struct vspm_entry_vsp *vsp = &entry->ip_par.vsp;
 
-	struct vsp_dl_t *dl_par = &vsp->par.dl_par;
-	unsigned long tmp_addr;
-
 	int ercd = 0;
 
 	int i;
@@ -640,18 +2053,11 @@ int set_vsp_par(
 		return -EFAULT;
 	}
 
-	/* get work buffer */
-	vsp->work_buff = get_work_buffer(entry->priv);
-	if (!vsp->work_buff)
-		return -EFAULT;
-
 	/* copy vsp_src_t parameter */
 	for (i = 0; i < 5; i++) {
 		if (vsp->par.src_par[i]) {
 			ercd = set_vsp_src_par(
-				&vsp->in[i],
-				vsp->par.src_par[i],
-				vsp->work_buff);
+				&vsp->in[i], vsp->par.src_par[i]);
 			if (ercd)
 				goto err_exit;
 			vsp->par.src_par[i] = &vsp->in[i].in;
@@ -668,58 +2074,84 @@ int set_vsp_par(
 
 	/* copy vsp_ctrl_t parameter */
 	if (vsp->par.ctrl_par) {
-		ercd = set_vsp_ctrl_par(
-			&vsp->ctrl, vsp->par.ctrl_par, vsp->work_buff);
+		ercd = set_vsp_ctrl_par(&vsp->ctrl, vsp->par.ctrl_par);
 		if (ercd)
 			goto err_exit;
 		vsp->par.ctrl_par = &vsp->ctrl.ctrl;
 	}
 
-	/* assign memory for display list */
-	tmp_addr =
-		(unsigned long)vsp->work_buff->hard_addr +
-		(unsigned long)vsp->work_buff->offset;
-	dl_par->hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)vsp->work_buff->virt_addr +
-		(unsigned long)vsp->work_buff->offset;
-	dl_par->virt_addr = (void *)tmp_addr;
-	dl_par->tbl_num = (VSPM_IF_MEM_SIZE - vsp->work_buff->offset) >> 3;
+	/* assign work buffer of the job size */
+	ercd = set_vsp_work_buff(entry->priv, vsp, NULL, 0);
+	if (ercd)
+		goto err_exit;
 
 	return 0;
 
 err_exit:
-	free_vsp_par(vsp);
+	free_vsp_par(entry->priv, vsp);
 	return ercd;
 }
 
-int free_cb_vsp_par(struct vspm_if_cb_data_t *cb_data)
+void put_cb_data(struct vspm_if_cb_data_t *cb_data)
 {
-	if (cb_data->vsp_work_buff)
-		cb_data->vsp_work_buff->use_flag = 0;
+	/* release the entry data including the callback data */
+	put_entry_data(container_of(
+		cb_data, struct vspm_if_entry_data_t, cb_data));
+}
 
-	return 0;
+void copy_cb_histogram(struct vspm_if_cb_data_t *cb_data)
+{
+	unsigned long tmp_addr;
+
+	/* HGO result */
+	if (cb_data->vsp_hgo.virt_addr && cb_data->vsp_hgo.user_addr) {
+		tmp_addr = (unsigned long)(cb_data->vsp_hgo.virt_addr);
+		tmp_addr = (tmp_addr + 255) >> 8;
+		/* copy to user area */
+		if (copy_to_user((void __user *)cb_data->vsp_hgo.user_addr,
+				 (void *)(tmp_addr << 8),
+				 1088))
+			APRINT("failed to copy HGO data\n");
+	}
+
+	/* HGT result */
+	if (cb_data->vsp_hgt.virt_addr && cb_data->vsp_hgt.user_addr) {
+		tmp_addr = (unsigned long)(cb_data->vsp_hgt.virt_addr);
+		tmp_addr = (tmp_addr + 255) >> 8;
+		/* copy to user area */
+		if (copy_to_user((void __user *)cb_data->vsp_hgt.user_addr,
+				 (void *)(tmp_addr << 8),
+				 800))
+			APRINT("failed to copy HGT data\n");
+	}
 }
 
 void set_cb_rsp_vsp(
 	struct vspm_if_cb_data_t *cb_data,
 	struct vspm_if_entry_data_t *entry_data)
 {
-	struct vspm_entry_vsp_hgo *hgo =
-		&entry_data->ip_par.vsp.ctrl.hgo;
-	struct vspm_entry_vsp_hgt *hgt =
-		&entry_data->ip_par.vsp.ctrl.hgt;
-
-	/* inherits histogram(HGO) buffer address */
-	cb_data->vsp_hgo.virt_addr = hgo->hgo.virt_addr;
-	cb_data->vsp_hgo.user_addr = hgo->user_addr;
-
-	/* inherits histogram(HGT) buffer address */
-	cb_data->vsp_hgt.virt_addr = hgt->hgt.virt_addr;
-	cb_data->vsp_hgt.user_addr = hgt->user_addr;
+	struct vspm_entry_vsp *vsp = &entry_data->ip_par.vsp;
+	struct vspm_entry_vsp_hgo *hgo = &vsp->ctrl.hgo;
+	struct vspm_entry_vsp_hgt *hgt = &vsp->ctrl.hgt;
+	struct vsp_ctrl_t *ctrl_par = vsp->par.ctrl_par;
+
+	/* the entry data may be reused, see only the used histogram */
+	if (entry_data->job.par.vsp && ctrl_par) {
+		if (ctrl_par->hgo || ctrl_par->hgt)
+			sync_work_buffer_for_cpu(vsp->work_buff);
+
+		/* inherits histogram(HGO) buffer address */
+		if (ctrl_par->hgo) {
+			cb_data->vsp_hgo.virt_addr = hgo->hgo.virt_addr;
+			cb_data->vsp_hgo.user_addr = hgo->user_addr;
+		}
 
-	/* inherits work buffer */
-	cb_data->vsp_work_buff = entry_data->ip_par.vsp.work_buff;
+		/* inherits histogram(HGT) buffer address */
+		if (ctrl_par->hgt) {
+			cb_data->vsp_hgt.virt_addr = hgt->hgt.virt_addr;
+			cb_data->vsp_hgt.user_addr = hgt->user_addr;
+		}
+	}
 }
 
 static int set_fdp_ref_par(
@@ -869,63 +2301,174 @@ int set_fdp_par(
 	return 0;
 }
 
+static int set_vsp_patch_par(
+	struct vsp_start_t *vsp_par, struct vspm_if_patch_t *patch)
+{
+	struct vsp_src_t *src;
+	struct vsp_dst_t *dst = vsp_par->dst_par;
+
+	switch (patch->target) {
+	case VSPM_IF_PATCH_SRC_ADDR:
+	case VSPM_IF_PATCH_SRC_ADDR_C0:
+	case VSPM_IF_PATCH_SRC_ADDR_C1:
+	case VSPM_IF_PATCH_SRC_ADDR_A:
+		if (patch->index >= 5 || !vsp_par->src_par[patch->index])
+			return -EINVAL;
+		src = vsp_par->src_par[patch->index];
+
+		if (patch->target == VSPM_IF_PATCH_SRC_ADDR) {
+			src->addr = patch->value;
+		} else if (patch->target == VSPM_IF_PATCH_SRC_ADDR_C0) {
+			src->addr_c0 = patch->value;
+		} else if (patch->target == VSPM_IF_PATCH_SRC_ADDR_C1) {
+			src->addr_c1 = patch->value;
+		} else {
+			if (!src->alpha)
+				return -EINVAL;
+			src->alpha->addr_a = patch->value;
+		}
+		break;
+	case VSPM_IF_PATCH_DST_ADDR:
+		if (!dst)
+			return -EINVAL;
+		dst->addr = patch->value;
+		break;
+	case VSPM_IF_PATCH_DST_ADDR_C0:
+		if (!dst)
+			return -EINVAL;
+		dst->addr_c0 = patch->value;
+		break;
+	case VSPM_IF_PATCH_DST_ADDR_C1:
+		if (!dst)
+			return -EINVAL;
+		dst->addr_c1 = patch->value;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int set_fdp_patch_par(
+	struct fdp_start_t *fdp_par, struct vspm_if_patch_t *patch)
+{
+	struct fdp_fproc_t *fproc = fdp_par->fproc_par;
+	struct fdp_imgbuf_t *imgbuf = NULL;
+
+	if (!fproc)
+		return -EINVAL;
+
+	switch (patch->target) {
+	case VSPM_IF_PATCH_FDP_PICID:
+		if (!fproc->in_pic)
+			return -EINVAL;
+		fproc->in_pic->picid = (unsigned long)patch->value;
+		return 0;
+	case VSPM_IF_PATCH_FDP_CURRENT_FIELD:
+		fproc->current_field = (unsigned char)patch->value;
+		return 0;
+	case VSPM_IF_PATCH_FDP_OUT_ADDR:
+	case VSPM_IF_PATCH_FDP_OUT_ADDR_C0:
+	case VSPM_IF_PATCH_FDP_OUT_ADDR_C1:
+		imgbuf = fproc->out_buf;
+		break;
+	case VSPM_IF_PATCH_FDP_REF_ADDR:
+	case VSPM_IF_PATCH_FDP_REF_ADDR_C0:
+	case VSPM_IF_PATCH_FDP_REF_ADDR_C1:
+		if (!fproc->ref_buf)
+			return -EINVAL;
+		/* index 0:next, 1:current, 2:previous */
+		if (patch->index == 0)
+			imgbuf = fproc->ref_buf->next_buf;
+		else if (patch->index == 1)
+			imgbuf = fproc->ref_buf->cur_buf;
+		else if (patch->index == 2)
+			imgbuf = fproc->ref_buf->prev_buf;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!imgbuf)
+		return -EINVAL;
+
+	switch (patch->target) {
+	case VSPM_IF_PATCH_FDP_OUT_ADDR:
+	case VSPM_IF_PATCH_FDP_REF_ADDR:
+		imgbuf->addr = patch->value;
+		break;
+	case VSPM_IF_PATCH_FDP_OUT_ADDR_C0:
+	case VSPM_IF_PATCH_FDP_REF_ADDR_C0:
+		imgbuf->addr_c0 = patch->value;
+		break;
+	default:
+		imgbuf->addr_c1 = patch->value;
+		break;
+	}
+
+	return 0;
+}
+
+int set_patch_par(
+	struct vspm_if_entry_data_t *entry, struct vspm_if_patch_t *patch)
+{
+	switch (entry->job.type) {
+	case VSPM_TYPE_VSP_AUTO:
+		if (!entry->job.par.vsp)
+			return -EINVAL;
+		return set_vsp_patch_par(entry->job.par.vsp, patch);
+	case VSPM_TYPE_FDP_AUTO:
+		if (!entry->job.par.fdp)
+			return -EINVAL;
+		return set_fdp_patch_par(entry->job.par.fdp, patch);
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
 static int set_compat_vsp_src_clut_par(
 	struct vsp_dl_t *clut,
 	unsigned int src,
-	struct vspm_if_work_buff_t *work_buff)
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_dl_t compat_dl_par;
-	unsigned long tmp_addr;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_dl_par,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_dl_t))) {
 		EPRINT("failed to copy of vsp_dl_t\n");
 		return -EFAULT;
 	}
 
-	if (compat_dl_par.virt_addr != 0 &&
-	    compat_dl_par.tbl_num > 0 &&
-	    compat_dl_par.tbl_num <= 256) {
-		tmp_addr =
-			(unsigned long)work_buff->virt_addr +
-			(unsigned long)work_buff->offset;
-
-		/* copy color table */
-		if (copy_from_user(
-				(void *)tmp_addr,
-				VSPM_IF_INT_TO_UP(compat_dl_par.virt_addr),
-				compat_dl_par.tbl_num * 8)) {
-			EPRINT("failed to copy color table\n");
-			return -EFAULT;
-		}
-
-		/* set parameter */
-		clut->virt_addr = (void *)tmp_addr;
-		tmp_addr =
-			(unsigned long)work_buff->hard_addr +
-			(unsigned long)work_buff->offset;
-		clut->hard_addr = (unsigned int)tmp_addr;
-		clut->tbl_num = compat_dl_par.tbl_num;
-
-		/* increment memory offset */
-		work_buff->offset += VSPM_IF_RPF_CLUT_SIZE;
-	}
+	/*
+	 * set parameter, virt_addr keeps the source of the color table
+	 * until it is copied to the work buffer by set_vsp_work_buff().
+	 */
+	clut->hard_addr = compat_dl_par.hard_addr;
+	clut->virt_addr = VSPM_IF_INT_TO_VP(compat_dl_par.virt_addr);
+	clut->tbl_num = compat_dl_par.tbl_num;
 
 	return 0;
 }
 
 static int set_compat_vsp_irop_par(
-	struct vsp_irop_unit_t *irop, unsigned int src)
+	struct vsp_irop_unit_t *irop,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_irop_unit_t compat_irop;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_irop,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_irop_unit_t))) {
 		EPRINT("failed to copy of vsp_irop_unit_t\n");
 		return -EFAULT;
@@ -943,14 +2486,17 @@ static int set_compat_vsp_irop_par(
 }
 
 static int set_compat_vsp_ckey_par(
-	struct vsp_ckey_unit_t *ckey, unsigned int src)
+	struct vsp_ckey_unit_t *ckey,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_ckey_unit_t compat_ckey;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_ckey,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_ckey_unit_t))) {
 		EPRINT("failed to copy of vsp_ckey_unit_t\n");
 		return -EFAULT;
@@ -965,15 +2511,21 @@ static int set_compat_vsp_ckey_par(
 }
 
 static int set_compat_vsp_src_alpha_par(
-	struct vspm_entry_vsp_in_alpha *alpha, unsigned int src)
+	struct vspm_entry_vsp_in_alpha *alpha,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_alpha_unit_t compat_alpha;
 	int ercd;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&alpha->alpha, 0, sizeof(struct vsp_alpha_unit_t));
+
 	/* copy vsp_alpha_unit_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_alpha,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_alpha_unit_t))) {
 		EPRINT("failed to copy of vsp_alpha_unit_t\n");
 		return -EFAULT;
@@ -990,7 +2542,8 @@ static int set_compat_vsp_src_alpha_par(
 
 	/* copy vsp_irop_unit_t paramerter */
 	if (compat_alpha.irop) {
-		ercd = set_compat_vsp_irop_par(&alpha->irop, compat_alpha.irop);
+		ercd = set_compat_vsp_irop_par(
+			&alpha->irop, compat_alpha.irop, flat);
 		if (ercd)
 			return ercd;
 		alpha->alpha.irop = &alpha->irop;
@@ -998,7 +2551,8 @@ static int set_compat_vsp_src_alpha_par(
 
 	/* copy vsp_ckey_unit_t paramerter */
 	if (compat_alpha.ckey) {
-		ercd = set_compat_vsp_ckey_par(&alpha->ckey, compat_alpha.ckey);
+		ercd = set_compat_vsp_ckey_par(
+			&alpha->ckey, compat_alpha.ckey, flat);
 		if (ercd)
 			return ercd;
 		alpha->alpha.ckey = &alpha->ckey;
@@ -1006,9 +2560,10 @@ static int set_compat_vsp_src_alpha_par(
 
 	/* copy vsp_mult_unit_t paramerter */
 	if (compat_alpha.mult) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&alpha->mult,
-				VSPM_IF_INT_TO_UP(compat_alpha.mult),
+				flat,
+				compat_alpha.mult,
 				sizeof(struct vsp_mult_unit_t))) {
 			EPRINT("failed to copy of vsp_mult_unit_t\n");
 			return -EFAULT;
@@ -1022,15 +2577,19 @@ static int set_compat_vsp_src_alpha_par(
 static int set_compat_vsp_src_par(
 	struct vspm_entry_vsp_in *in,
 	unsigned int src,
-	struct vspm_if_work_buff_t *work_buff)
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_src_t compat_vsp_src;
 	int ercd;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&in->in, 0, sizeof(struct vsp_src_t));
+
 	/* copy vsp_src_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_vsp_src,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_src_t))) {
 		EPRINT("failed to copy of vsp_src_t\n");
 		return -EFAULT;
@@ -1064,7 +2623,7 @@ static int set_compat_vsp_src_par(
 	/* copy vsp_dl_t parameter */
 	if (compat_vsp_src.clut) {
 		ercd = set_compat_vsp_src_clut_par(
-			&in->clut, compat_vsp_src.clut, work_buff);
+			&in->clut, compat_vsp_src.clut, flat);
 		if (ercd)
 			return ercd;
 		in->in.clut = &in->clut;
@@ -1073,7 +2632,7 @@ static int set_compat_vsp_src_par(
 	/* copy vsp_alpha_unit_t parameter */
 	if (compat_vsp_src.alpha) {
 		ercd = set_compat_vsp_src_alpha_par(
-			&in->alpha, compat_vsp_src.alpha);
+			&in->alpha, compat_vsp_src.alpha, flat);
 		if (ercd)
 			return ercd;
 		in->in.alpha = &in->alpha.alpha;
@@ -1083,14 +2642,20 @@ static int set_compat_vsp_src_par(
 }
 
 static int set_compat_vsp_dst_par(
-	struct vspm_entry_vsp_out *out, unsigned int src)
+	struct vspm_entry_vsp_out *out,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_dst_t compat_vsp_dst;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&out->out, 0, sizeof(struct vsp_dst_t));
+
 	/* copy vsp_dst_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_vsp_dst,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_dst_t))) {
 		EPRINT("failed to copy of vsp_dst_t\n");
 		return -EFAULT;
@@ -1123,9 +2688,10 @@ static int set_compat_vsp_dst_par(
 
 	/* copy fcp_info_t parameter */
 	if (compat_vsp_dst.fcp) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&out->fcp,
-				VSPM_IF_INT_TO_UP(compat_vsp_dst.fcp),
+				flat,
+				compat_vsp_dst.fcp,
 				sizeof(struct fcp_info_t))) {
 			EPRINT("failed to copy to fcp_info_t\n");
 			return -EFAULT;
@@ -1136,14 +2702,18 @@ static int set_compat_vsp_dst_par(
 	return 0;
 }
 
-static int set_compat_vsp_sru_par(struct vsp_sru_t *sru, unsigned int src)
+static int set_compat_vsp_sru_par(
+	struct vsp_sru_t *sru,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_sru_t compat_sru;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_sru,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_sru_t))) {
 		EPRINT("failed to copy of vsp_sru_t\n");
 		return -EFAULT;
@@ -1159,14 +2729,18 @@ static int set_compat_vsp_sru_par(struct vsp_sru_t *sru, unsigned int src)
 	return 0;
 }
 
-static int set_compat_vsp_uds_par(struct vsp_uds_t *uds, unsigned int src)
+static int set_compat_vsp_uds_par(
+	struct vsp_uds_t *uds,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_uds_t compat_uds;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_uds,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_uds_t))) {
 		EPRINT("failed to copy of vsp_uds_t\n");
 		return -EFAULT;
@@ -1189,14 +2763,18 @@ static int set_compat_vsp_uds_par(struct vsp_uds_t *uds, unsigned int src)
 	return 0;
 }
 
-static int set_compat_vsp_lut_par(struct vsp_lut_t *lut, unsigned int src)
+static int set_compat_vsp_lut_par(
+	struct vsp_lut_t *lut,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_lut_t compat_lut;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_lut,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_lut_t))) {
 		EPRINT("failed to copy of vsp_lut_t\n");
 		return -EFAULT;
@@ -1212,14 +2790,18 @@ static int set_compat_vsp_lut_par(struct vsp_lut_t *lut, unsigned int src)
 	return 0;
 }
 
-static int set_compat_vsp_clu_par(struct vsp_clu_t *clu, unsigned int src)
+static int set_compat_vsp_clu_par(
+	struct vsp_clu_t *clu,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_clu_t compat_clu;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_clu,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_clu_t))) {
 		EPRINT("failed to copy of vsp_clu_t\n");
 		return -EFAULT;
@@ -1236,14 +2818,18 @@ static int set_compat_vsp_clu_par(struct vsp_clu_t *clu, unsigned int src)
 	return 0;
 }
 
-static int set_compat_vsp_hst_par(struct vsp_hst_t *hst, unsigned int src)
+static int set_compat_vsp_hst_par(
+	struct vsp_hst_t *hst,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_hst_t compat_hst;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_hst,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_hst_t))) {
 		EPRINT("failed to copy of vsp_hst_t\n");
 		return -EFAULT;
@@ -1256,14 +2842,18 @@ static int set_compat_vsp_hst_par(struct vsp_hst_t *hst, unsigned int src)
 	return 0;
 }
 
-static int set_compat_vsp_hsi_par(struct vsp_hsi_t *hsi, unsigned int src)
+static int set_compat_vsp_hsi_par(
+	struct vsp_hsi_t *hsi,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_hsi_t compat_hsi;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_hsi,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_hsi_t))) {
 		EPRINT("failed to copy of vsp_hsi_t\n");
 		return -EFAULT;
@@ -1277,14 +2867,17 @@ static int set_compat_vsp_hsi_par(struct vsp_hsi_t *hsi, unsigned int src)
 }
 
 static int set_compat_vsp_bru_vir_par(
-	struct vsp_bld_vir_t *vir, unsigned int src)
+	struct vsp_bld_vir_t *vir,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_bld_vir_t compat_vir;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_vir,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_bld_vir_t))) {
 		EPRINT("failed to copy of vsp_bld_vir_t\n");
 		return -EFAULT;
@@ -1302,17 +2895,23 @@ static int set_compat_vsp_bru_vir_par(
 }
 
 static int set_compat_vsp_bru_par(
-	struct vspm_entry_vsp_bru *bru, unsigned int src)
+	struct vspm_entry_vsp_bru *bru,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct vsp_bld_ctrl_t **src_blend[5];
 	struct compat_vsp_bru_t compat_bru;
 	int ercd;
 	int i;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&bru->bru, 0, sizeof(struct vsp_bru_t));
+
 	/* copy vsp_bru_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_bru,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_bru_t))) {
 		EPRINT("failed to copy of vsp_bru_t\n");
 		return -EFAULT;
@@ -1325,10 +2924,10 @@ static int set_compat_vsp_bru_par(
 	/* copy vsp_bld_dither_t parameter */
 	for (i = 0; i < 5; i++) {
 		if (compat_bru.dither_unit[i]) {
-			if (copy_from_user(
+			if (copy_from_compat(
 					&bru->dither_unit[i],
-					VSPM_IF_INT_TO_UP(
-						compat_bru.dither_unit[i]),
+					flat,
+					compat_bru.dither_unit[i],
 					sizeof(struct vsp_bld_dither_t))) {
 				EPRINT("failed to copy of vsp_bld_dither_t\n");
 				return -EFAULT;
@@ -1340,7 +2939,9 @@ static int set_compat_vsp_bru_par(
 	/* copy vsp_bld_vir_t parameter */
 	if (compat_bru.blend_virtual) {
 		ercd = set_compat_vsp_bru_vir_par(
-			&bru->blend_virtual, compat_bru.blend_virtual);
+			&bru->blend_virtual,
+			compat_bru.blend_virtual,
+			flat);
 		if (ercd)
 			return ercd;
 		bru->bru.blend_virtual = &bru->blend_virtual;
@@ -1355,9 +2956,10 @@ static int set_compat_vsp_bru_par(
 
 	for (i = 0; i < 5; i++) {
 		if (compat_bru.blend_unit[i]) {
-			if (copy_from_user(
+			if (copy_from_compat(
 					&bru->blend_unit[i],
-				    VSPM_IF_INT_TO_UP(compat_bru.blend_unit[i]),
+					flat,
+					compat_bru.blend_unit[i],
 					sizeof(struct vsp_bld_ctrl_t))) {
 				EPRINT("failed to copy of vsp_bld_ctrl_t\n");
 				return -EFAULT;
@@ -1368,9 +2970,10 @@ static int set_compat_vsp_bru_par(
 
 	/* copy vsp_bld_rop_t parameter */
 	if (compat_bru.rop_unit) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&bru->rop_unit,
-				VSPM_IF_INT_TO_UP(compat_bru.rop_unit),
+				flat,
+				compat_bru.rop_unit,
 				sizeof(struct vsp_bld_rop_t))) {
 			EPRINT("failed to copy of vsp_bld_rop_t\n");
 			return -EFAULT;
@@ -1384,29 +2987,23 @@ static int set_compat_vsp_bru_par(
 static int set_compat_vsp_hgo_par(
 	struct vspm_entry_vsp_hgo *hgo,
 	unsigned int src,
-	struct vspm_if_work_buff_t *work_buff)
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_hgo_t compat_hgo;
-	unsigned long tmp_addr;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_hgo,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_hgo_t))) {
 		EPRINT("failed to copy of vsp_hgo_t\n");
 		return -EFAULT;
 	}
 
-	/* set */
-	tmp_addr =
-		(unsigned long)work_buff->hard_addr +
-		(unsigned long)work_buff->offset;
-	hgo->hgo.hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)work_buff->virt_addr +
-		(unsigned long)work_buff->offset;
-	hgo->hgo.virt_addr = (void *)tmp_addr;
+	/* set (the result area is assigned by set_vsp_work_buff()) */
+	hgo->hgo.hard_addr = 0;
+	hgo->hgo.virt_addr = NULL;
 
 	hgo->hgo.width = compat_hgo.width;
 	hgo->hgo.height = compat_hgo.height;
@@ -1421,40 +3018,31 @@ static int set_compat_vsp_hgo_par(
 
 	hgo->user_addr = VSPM_IF_INT_TO_VP(compat_hgo.virt_addr);
 
-	/* increment memory offset */
-	work_buff->offset += VSPM_IF_HGO_SIZE;
-
 	return 0;
 }
 
 static int set_compat_vsp_hgt_par(
 	struct vspm_entry_vsp_hgt *hgt,
 	unsigned int src,
-	struct vspm_if_work_buff_t *work_buff)
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_hgt_t compat_hgt;
-	unsigned long tmp_addr;
 
 	int i;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_hgt,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_hgt_t))) {
 		EPRINT("failed to copy of vsp_hgt_t\n");
 		return -EFAULT;
 	}
 
-	/* set */
-	tmp_addr =
-		(unsigned long)work_buff->hard_addr +
-		(unsigned long)work_buff->offset;
-	hgt->hgt.hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)work_buff->virt_addr +
-		(unsigned long)work_buff->offset;
-	hgt->hgt.virt_addr = (void *)tmp_addr;
+	/* set (the result area is assigned by set_vsp_work_buff()) */
+	hgt->hgt.hard_addr = 0;
+	hgt->hgt.virt_addr = NULL;
 
 	hgt->hgt.width = compat_hgt.width;
 	hgt->hgt.height = compat_hgt.height;
@@ -1470,20 +3058,21 @@ static int set_compat_vsp_hgt_par(
 
 	hgt->user_addr = VSPM_IF_INT_TO_VP(compat_hgt.virt_addr);
 
-	/* increment memory offset */
-	work_buff->offset += VSPM_IF_HGT_SIZE;
-
 	return 0;
 }
 
-static int set_compat_vsp_shp_par(struct vsp_shp_t *shp, unsigned int src)
+static int set_compat_vsp_shp_par(
+	struct vsp_shp_t *shp,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_shp_t compat_shp;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_shp,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_shp_t))) {
 		EPRINT("failed to copy of vsp_shp_t\n");
 		return -EFAULT;
@@ -1510,15 +3099,19 @@ static int set_compat_vsp_shp_par(struct vsp_shp_t *shp, unsigned int src)
 static int set_compat_vsp_ctrl_par(
 	struct vspm_entry_vsp_ctrl *ctrl,
 	unsigned int src,
-	struct vspm_if_work_buff_t *work_buff)
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_vsp_ctrl_t compat_vsp_ctrl;
 	int ercd;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&ctrl->ctrl, 0, sizeof(struct vsp_ctrl_t));
+
 	/* copy vsp_ctrl_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_vsp_ctrl,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_ctrl_t))) {
 		EPRINT("failed to copy of vsp_ctrl_t\n");
 		return -EFAULT;
@@ -1526,7 +3119,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_sru_t parameter */
 	if (compat_vsp_ctrl.sru) {
-		ercd = set_compat_vsp_sru_par(&ctrl->sru, compat_vsp_ctrl.sru);
+		ercd = set_compat_vsp_sru_par(
+			&ctrl->sru, compat_vsp_ctrl.sru, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.sru = &ctrl->sru;
@@ -1534,7 +3128,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_uds_t parameter */
 	if (compat_vsp_ctrl.uds) {
-		ercd = set_compat_vsp_uds_par(&ctrl->uds, compat_vsp_ctrl.uds);
+		ercd = set_compat_vsp_uds_par(
+			&ctrl->uds, compat_vsp_ctrl.uds, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.uds = &ctrl->uds;
@@ -1542,7 +3137,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_lut_t parameter */
 	if (compat_vsp_ctrl.lut) {
-		ercd = set_compat_vsp_lut_par(&ctrl->lut, compat_vsp_ctrl.lut);
+		ercd = set_compat_vsp_lut_par(
+			&ctrl->lut, compat_vsp_ctrl.lut, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.lut = &ctrl->lut;
@@ -1550,7 +3146,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_clu_t parameter */
 	if (compat_vsp_ctrl.clu) {
-		ercd = set_compat_vsp_clu_par(&ctrl->clu, compat_vsp_ctrl.clu);
+		ercd = set_compat_vsp_clu_par(
+			&ctrl->clu, compat_vsp_ctrl.clu, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.clu = &ctrl->clu;
@@ -1558,7 +3155,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_hst_t parameter */
 	if (compat_vsp_ctrl.hst) {
-		ercd = set_compat_vsp_hst_par(&ctrl->hst, compat_vsp_ctrl.hst);
+		ercd = set_compat_vsp_hst_par(
+			&ctrl->hst, compat_vsp_ctrl.hst, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hst = &ctrl->hst;
@@ -1566,7 +3164,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_hsi_t parameter */
 	if (compat_vsp_ctrl.hsi) {
-		ercd = set_compat_vsp_hsi_par(&ctrl->hsi, compat_vsp_ctrl.hsi);
+		ercd = set_compat_vsp_hsi_par(
+			&ctrl->hsi, compat_vsp_ctrl.hsi, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hsi = &ctrl->hsi;
@@ -1574,7 +3173,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_bru_t parameter */
 	if (compat_vsp_ctrl.bru) {
-		ercd = set_compat_vsp_bru_par(&ctrl->bru, compat_vsp_ctrl.bru);
+		ercd = set_compat_vsp_bru_par(
+			&ctrl->bru, compat_vsp_ctrl.bru, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.bru = &ctrl->bru.bru;
@@ -1583,7 +3183,7 @@ static int set_compat_vsp_ctrl_par(
 	/* copy vsp_hgo_t parameter */
 	if (compat_vsp_ctrl.hgo) {
 		ercd = set_compat_vsp_hgo_par(
-			&ctrl->hgo, compat_vsp_ctrl.hgo, work_buff);
+			&ctrl->hgo, compat_vsp_ctrl.hgo, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hgo = &ctrl->hgo.hgo;
@@ -1592,7 +3192,7 @@ static int set_compat_vsp_ctrl_par(
 	/* copy vsp_hgt_t parameter */
 	if (compat_vsp_ctrl.hgt) {
 		ercd = set_compat_vsp_hgt_par(
-			&ctrl->hgt, compat_vsp_ctrl.hgt, work_buff);
+			&ctrl->hgt, compat_vsp_ctrl.hgt, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.hgt = &ctrl->hgt.hgt;
@@ -1600,7 +3200,8 @@ static int set_compat_vsp_ctrl_par(
 
 	/* copy vsp_shp_t parameter */
 	if (compat_vsp_ctrl.shp) {
-		ercd = set_compat_vsp_shp_par(&ctrl->shp, compat_vsp_ctrl.shp);
+		ercd = set_compat_vsp_shp_par(
+			&ctrl->shp, compat_vsp_ctrl.shp, flat);
 		if (ercd)
 			return ercd;
 		ctrl->ctrl.shp = &ctrl->shp;
@@ -1610,20 +3211,25 @@ static int set_compat_vsp_ctrl_par(
 }
 
 int set_compat_vsp_par(
-	struct vspm_if_entry_data_t *entry, unsigned int src)
+	struct vspm_if_entry_data_t *entry,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct vspm_entry_vsp *vsp = &entry->ip_par.vsp;
 	struct compat_vsp_start_t compat_vsp_par;
-	unsigned long tmp_addr;
 
 	int ercd;
 
 	int i;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&vsp->par, 0, sizeof(struct vsp_start_t));
+
 	/* copy vsp_start_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_vsp_par,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_vsp_start_t))) {
 		EPRINT("failed to copy of vsp_start_t\n");
 		return -EFAULT;
@@ -1633,18 +3239,13 @@ int set_compat_vsp_par(
 	vsp->par.rpf_order = 0;	/* not used */
 	vsp->par.use_module = (unsigned long)compat_vsp_par.use_module;
 
-	/* get work buffer */
-	vsp->work_buff = get_work_buffer(entry->priv);
-	if (!vsp->work_buff)
-		return -EFAULT;
-
 	/* copy vsp_src_t parameter */
 	for (i = 0; i < 5; i++) {
 		if (compat_vsp_par.src_par[i]) {
 			ercd = set_compat_vsp_src_par(
 				&vsp->in[i],
 				compat_vsp_par.src_par[i],
-				vsp->work_buff);
+				flat);
 			if (ercd)
 				goto err_exit;
 			vsp->par.src_par[i] = &vsp->in[i].in;
@@ -1654,7 +3255,7 @@ int set_compat_vsp_par(
 	/* copy vsp_dst_t parameter */
 	if (compat_vsp_par.dst_par) {
 		ercd = set_compat_vsp_dst_par(
-			&vsp->out, compat_vsp_par.dst_par);
+			&vsp->out, compat_vsp_par.dst_par, flat);
 		if (ercd)
 			goto err_exit;
 		vsp->par.dst_par = &vsp->out.out;
@@ -1663,39 +3264,38 @@ int set_compat_vsp_par(
 	/* copy vsp_ctrl_t parameter */
 	if (compat_vsp_par.ctrl_par) {
 		ercd = set_compat_vsp_ctrl_par(
-			&vsp->ctrl, compat_vsp_par.ctrl_par, vsp->work_buff);
+			&vsp->ctrl,
+			compat_vsp_par.ctrl_par,
+			flat);
 		if (ercd)
 			goto err_exit;
 		vsp->par.ctrl_par = &vsp->ctrl.ctrl;
 	}
 
-	/* assign memory for display list */
-	tmp_addr =
-		(unsigned long)vsp->work_buff->hard_addr +
-		(unsigned long)vsp->work_buff->offset;
-	vsp->par.dl_par.hard_addr = (unsigned int)tmp_addr;
-	tmp_addr =
-		(unsigned long)vsp->work_buff->virt_addr +
-		(unsigned long)vsp->work_buff->offset;
-	vsp->par.dl_par.virt_addr = (void *)tmp_addr;
-	vsp->par.dl_par.tbl_num =
-		(VSPM_IF_MEM_SIZE - vsp->work_buff->offset) >> 3;
+	/* assign work buffer of the job size */
+	ercd = set_vsp_work_buff(entry->priv, vsp, flat, 1);
+	if (ercd)
+		goto err_exit;
 
 	return 0;
 
 err_exit:
-	free_vsp_par(vsp);
+	free_vsp_par(entry->priv, vsp);
 	return ercd;
 }
 
-static int set_compat_fdp_pic_par(struct fdp_pic_t *in_pic, unsigned int src)
+static int set_compat_fdp_pic_par(
+	struct fdp_pic_t *in_pic,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_fdp_pic_t compat_fdp_pic;
 
 	/* copy */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_fdp_pic,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_fdp_pic_t))) {
 		EPRINT("failed to copy of fdp_pic_t\n");
 		return -EFAULT;
@@ -1716,23 +3316,30 @@ static int set_compat_fdp_pic_par(struct fdp_pic_t *in_pic, unsigned int src)
 }
 
 static int set_compat_fdp_ref_par(
-	struct vspm_entry_fdp_ref *ref, unsigned int src)
+	struct vspm_entry_fdp_ref *ref,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_fdp_refbuf_t compat_fdp_refbuf;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&ref->ref_buf, 0, sizeof(struct fdp_refbuf_t));
+
 	/* copy fdp_refbuf_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_fdp_refbuf,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_fdp_refbuf_t))) {
 		EPRINT("failed to copy of fdp_refbuf_t\n");
 		return -EFAULT;
 	}
 
 	if (compat_fdp_refbuf.next_buf) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&ref->ref[0],
-				VSPM_IF_INT_TO_UP(compat_fdp_refbuf.next_buf),
+				flat,
+				compat_fdp_refbuf.next_buf,
 				sizeof(struct fdp_imgbuf_t))) {
 			EPRINT("failed to copy to fdp_imgbuf_t\n");
 			return -EFAULT;
@@ -1741,9 +3348,10 @@ static int set_compat_fdp_ref_par(
 	}
 
 	if (compat_fdp_refbuf.cur_buf) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&ref->ref[1],
-				VSPM_IF_INT_TO_UP(compat_fdp_refbuf.cur_buf),
+				flat,
+				compat_fdp_refbuf.cur_buf,
 				sizeof(struct fdp_imgbuf_t))) {
 			EPRINT("failed to copy to fdp_imgbuf_t\n");
 			return -EFAULT;
@@ -1752,9 +3360,10 @@ static int set_compat_fdp_ref_par(
 	}
 
 	if (compat_fdp_refbuf.prev_buf) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&ref->ref[2],
-				VSPM_IF_INT_TO_UP(compat_fdp_refbuf.prev_buf),
+				flat,
+				compat_fdp_refbuf.prev_buf,
 				sizeof(struct fdp_imgbuf_t))) {
 			EPRINT("failed to copy to fdp_imgbuf_t\n");
 			return -EFAULT;
@@ -1766,15 +3375,21 @@ static int set_compat_fdp_ref_par(
 }
 
 static int set_compat_fdp_fproc_par(
-	struct vspm_entry_fdp_fproc *fproc, unsigned int src)
+	struct vspm_entry_fdp_fproc *fproc,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct compat_fdp_fproc_t compat_fdp_fproc;
 	int ercd;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&fproc->fproc, 0, sizeof(struct fdp_fproc_t));
+
 	/* copy fdp_fproc_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_fdp_fproc,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_fdp_fproc_t))) {
 		EPRINT("failed to copy of fdp_fproc_t\n");
 		return -EFAULT;
@@ -1787,9 +3402,10 @@ static int set_compat_fdp_fproc_par(
 
 	/* copy fdp_seq_t parameter */
 	if (compat_fdp_fproc.seq_par) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&fproc->seq,
-				VSPM_IF_INT_TO_UP(compat_fdp_fproc.seq_par),
+				flat,
+				compat_fdp_fproc.seq_par,
 				sizeof(struct fdp_seq_t))) {
 			EPRINT("failed to copy to fdp_seq_t\n");
 			return -EFAULT;
@@ -1800,7 +3416,7 @@ static int set_compat_fdp_fproc_par(
 	/* copy fdp_pic_t parameter */
 	if (compat_fdp_fproc.in_pic) {
 		ercd = set_compat_fdp_pic_par(
-			&fproc->in_pic, compat_fdp_fproc.in_pic);
+			&fproc->in_pic, compat_fdp_fproc.in_pic, flat);
 		if (ercd)
 			return ercd;
 		fproc->fproc.in_pic = &fproc->in_pic;
@@ -1808,9 +3424,10 @@ static int set_compat_fdp_fproc_par(
 
 	/* copy fdp_imgbuf_t parameter */
 	if (compat_fdp_fproc.out_buf) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&fproc->out_buf,
-				VSPM_IF_INT_TO_UP(compat_fdp_fproc.out_buf),
+				flat,
+				compat_fdp_fproc.out_buf,
 				sizeof(struct fdp_imgbuf_t))) {
 			EPRINT("failed to copy to fdp_imgbuf_t\n");
 			return -EFAULT;
@@ -1821,7 +3438,7 @@ static int set_compat_fdp_fproc_par(
 	/* copy fdp_refbuf_t parameter */
 	if (compat_fdp_fproc.ref_buf) {
 		ercd = set_compat_fdp_ref_par(
-			&fproc->ref, compat_fdp_fproc.ref_buf);
+			&fproc->ref, compat_fdp_fproc.ref_buf, flat);
 		if (ercd)
 			return ercd;
 		fproc->fproc.ref_buf = &fproc->ref.ref_buf;
@@ -1829,9 +3446,10 @@ static int set_compat_fdp_fproc_par(
 
 	/* copy fcp_info_t parameter */
 	if (compat_fdp_fproc.fcp_par) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&fproc->fcp,
-				VSPM_IF_INT_TO_UP(compat_fdp_fproc.fcp_par),
+				flat,
+				compat_fdp_fproc.fcp_par,
 				sizeof(struct fcp_info_t))) {
 			EPRINT("failed to copy to fcp_info_t\n");
 			return -EFAULT;
@@ -1841,9 +3459,10 @@ static int set_compat_fdp_fproc_par(
 
 	/* copy fdp_ipc_t parameter */
 	if (compat_fdp_fproc.ipc_par) {
-		if (copy_from_user(
+		if (copy_from_compat(
 				&fproc->ipc,
-				VSPM_IF_INT_TO_UP(compat_fdp_fproc.ipc_par),
+				flat,
+				compat_fdp_fproc.ipc_par,
 				sizeof(struct fdp_ipc_t))) {
 			EPRINT("failed to copy to fdp_ipc_t\n");
 			return -EFAULT;
@@ -1855,16 +3474,22 @@ static int set_compat_fdp_fproc_par(
 }
 
 int set_compat_fdp_par(
-	struct vspm_if_entry_data_t *entry, unsigned int src)
+	struct vspm_if_entry_data_t *entry,
+	unsigned int src,
+	const struct vspm_if_flat_t *flat)
 {
 	struct vspm_entry_fdp *fdp = &entry->ip_par.fdp;
 	struct compat_fdp_start_t compat_fdp_par;
 	int ercd;
 
+	/* clear the parameter (the entry data may be reused) */
+	memset(&fdp->par, 0, sizeof(struct fdp_start_t));
+
 	/* copy fdp_start_t parameter */
-	if (copy_from_user(
+	if (copy_from_compat(
 			&compat_fdp_par,
-			VSPM_IF_INT_TO_UP(src),
+			flat,
+			src,
 			sizeof(struct compat_fdp_start_t))) {
 		EPRINT("failed to copy of fdp_start_t\n");
 		return -EFAULT;
@@ -1875,7 +3500,7 @@ int set_compat_fdp_par(
 	/* copy fdp_fproc_t parameter */
 	if (compat_fdp_par.fproc_par) {
 		ercd = set_compat_fdp_fproc_par(
-			&fdp->fproc, compat_fdp_par.fproc_par);
+			&fdp->fproc, compat_fdp_par.fproc_par, flat);
 		if (ercd)
 			return ercd;
 		fdp->par.fproc_par = &fdp->fproc.fproc;
@@ -1883,3 +3508,92 @@ int set_compat_fdp_par(
 
 	return 0;
 }
+
+int set_flat_par(
+	struct vspm_if_entry_data_t *entry,
+	struct vspm_if_entry_flat_req_t *req,
+	struct vspm_if_sq_t *sq)
+{
+	struct vspm_if_entry_req_t *entry_req = &entry->entry.req;
+	struct vspm_if_flat_job_t *flat_job;
+	struct vspm_if_flat_t flat;
+	unsigned char *buff;
+
+	int ercd = 0;
+
+	if (req->size < sizeof(struct vspm_if_flat_job_t) ||
+	    req->size > VSPM_IF_FLAT_MAX_SIZE)
+		return -EINVAL;
+
+	/* copy job descriptor */
+	buff = kmalloc(req->size, GFP_KERNEL);
+	if (!buff)
+		return -ENOMEM;
+
+	if (!sq) {
+		/* copy from user space */
+		if (copy_from_user(
+				buff, u64_to_user_ptr(req->job), req->size)) {
+			EPRINT("failed to copy of job descriptor\n");
+			kfree(buff);
+			return -EFAULT;
+		}
+	} else {
+		/* copy from data area of submission ring */
+		if (req->job >= VSPM_IF_SQ_DATA_SIZE ||
+		    req->size > VSPM_IF_SQ_DATA_SIZE - req->job) {
+			kfree(buff);
+			return -EFAULT;
+		}
+		memcpy(buff,
+		       (unsigned char *)sq + VSPM_IF_SQ_DATA_OFFSET + req->job,
+		       req->size);
+	}
+
+	flat.buff = buff;
+	flat.size = req->size;
+	flat_job = (struct vspm_if_flat_job_t *)buff;
+
+	entry_req->priority = req->priority;
+	entry_req->user_data = VSPM_IF_INT_TO_VP(req->user_data);
+	entry_req->cb_func = VSPM_IF_INT_TO_VP(req->cb_func);
+	entry_req->job_param = &entry->job;
+
+	entry->job.type = flat_job->type;
+
+	switch (flat_job->type) {
+	case VSPM_TYPE_VSP_AUTO:
+		/* set start parameter of VSP */
+		if (flat_job->par) {
+			ercd = set_compat_vsp_par(entry, flat_job->par, &flat);
+			if (ercd)
+				break;
+
+			entry->job.par.vsp = &entry->ip_par.vsp.par;
+
+			/* histogram results are returned to user address */
+			entry->ip_par.vsp.ctrl.hgo.user_addr =
+				VSPM_IF_INT_TO_VP(flat_job->hgo_addr);
+			entry->ip_par.vsp.ctrl.hgt.user_addr =
+				VSPM_IF_INT_TO_VP(flat_job->hgt_addr);
+		}
+		break;
+	case VSPM_TYPE_FDP_AUTO:
+		/* set start parameter of FDP */
+		if (flat_job->par) {
+			ercd = set_compat_fdp_par(entry, flat_job->par, &flat);
+			if (ercd)
+				break;
+
+			entry->job.par.fdp = &entry->ip_par.fdp.par;
+		}
+		break;
+	default:
+		break;
+	}
+
+	/* release job descriptor */
+	kfree(buff);
+
+	return ercd;
+}
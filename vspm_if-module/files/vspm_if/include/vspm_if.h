@@ -70,10 +70,60 @@ enum {
 	VSPM_CMD_WAIT_INTERRUPT,
 	VSPM_CMD_WAIT_THREAD,
 	VSPM_CMD_STOP_THREAD,
+	VSPM_CMD_ENTRY_BATCH,
+	VSPM_CMD_ENTRY_FLAT,
+	VSPM_CMD_TEMPLATE_REG,
+	VSPM_CMD_TEMPLATE_UNREG,
+	VSPM_CMD_TEMPLATE_ENTRY,
+	VSPM_CMD_CONFIG,
+	VSPM_CMD_REAP,
+	VSPM_CMD_SQ_ENTER,
+	VSPM_CMD_WAIT_TIMEOUT,
+	VSPM_CMD_ENTRY_SYNC,
+	VSPM_CMD_ENTRY_GRAPH,
+	VSPM_CMD_ENTRY_EX,
 };
 
 #define VSPM_IOC_MAGIC 'v'
 
+/* maximum number of jobs in one batch entry */
+#define VSPM_IF_ENTRY_BATCH_MAX		(32)
+
+/* maximum size of flat job descriptor */
+#define VSPM_IF_FLAT_MAX_SIZE		(16384)
+
+/* maximum number of patches in one template entry */
+#define VSPM_IF_PATCH_MAX		(16)
+
+/* maximum number of preallocated entry slots */
+#define VSPM_IF_DEPTH_MAX		(256)
+
+/* number of records in completion ring */
+#define VSPM_IF_CQ_NUM			(256)
+
+/* number of records and size of data area in submission ring */
+#define VSPM_IF_SQ_NUM			(64)
+#define VSPM_IF_SQ_DATA_SIZE		(256 * 1024)
+
+/* maximum number of jobs in one dependency graph */
+#define VSPM_IF_GRAPH_MAX		(16)
+
+/* maximum number of input fences of one job */
+#define VSPM_IF_FENCE_IN_MAX		(8)
+
+/* maximum number of dma-buf imports of one job, and cached dma-bufs */
+#define VSPM_IF_DMABUF_MAX		(24)
+#define VSPM_IF_DMABUF_CACHE_MAX	(32)
+
+/*
+ * ercd of the response of a job
+ *
+ * ercd is the return value of vspm_entry_job(), R_VSPM_OK or a negative
+ * R_VSPM_* code. When the driver does not entry the job, ercd is a
+ * positive errno instead (e.g. EFAULT for a bad parameter of a batch
+ * element, ECANCELED for a job cancelled before its entry).
+ */
+
 /* for 64bit */
 struct vspm_if_entry_t {
 	struct vspm_if_entry_req_t {
@@ -88,6 +138,11 @@ struct vspm_if_entry_t {
 	} rsp;
 };
 
+struct vspm_if_entry_batch_t {
+	unsigned int num;
+	struct vspm_if_entry_t *entry;
+};
+
 struct vspm_if_cb_rsp_t {
 	long ercd;
 	void *cb_func;
@@ -112,6 +167,366 @@ struct vspm_if_cb_rsp_t {
 	_IO(VSPM_IOC_MAGIC, VSPM_CMD_WAIT_THREAD)
 #define VSPM_IOC_CMD_STOP_THREAD \
 	_IO(VSPM_IOC_MAGIC, VSPM_CMD_STOP_THREAD)
+#define VSPM_IOC_CMD_ENTRY_BATCH \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_BATCH, \
+	struct vspm_if_entry_batch_t)
+
+/*
+ * flat job descriptor (common to 32bit and 64bit)
+ *
+ * The descriptor is one contiguous buffer that begins with
+ * struct vspm_if_flat_job_t. The start parameter and all of the
+ * parameters it refers to are laid out with the 32bit structures
+ * (struct compat_vsp_start_t, struct compat_fdp_start_t, ...), and every
+ * pointer member holds a byte offset from the top of the descriptor
+ * instead of an address (0 means NULL). This includes the color tables
+ * referred to by vsp_dl_t of the RPF CLUT. The hard_addr and virt_addr
+ * of the LUT/CLU tables are passed through as they are.
+ */
+struct vspm_if_flat_job_t {
+	unsigned short type;
+	unsigned int par;
+	unsigned long long hgo_addr;	/* user address of HGO result */
+	unsigned long long hgt_addr;	/* user address of HGT result */
+};
+
+struct vspm_if_entry_flat_t {
+	struct vspm_if_entry_flat_req_t {
+		unsigned long long job;		/* address of descriptor */
+		unsigned long long user_data;
+		unsigned long long cb_func;
+		unsigned int size;		/* size of descriptor */
+		char priority;
+		unsigned char reserved[3];
+	} req;
+	struct vspm_if_entry_flat_rsp_t {
+		unsigned long long job_id;
+		int ercd;
+		int reserved;
+	} rsp;
+};
+
+#define VSPM_IOC_CMD_ENTRY_FLAT \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_FLAT, \
+	struct vspm_if_entry_flat_t)
+
+/*
+ * job template (common to 32bit and 64bit)
+ *
+ * A template is registered with a flat job descriptor, and the driver
+ * keeps the converted parameters and the work buffer of the job.
+ * VSPM_IOC_CMD_TEMPLATE_ENTRY entries the job of the template after
+ * applying the patches. One template can have only one job in progress,
+ * the template is busy until the callback of the job is received by
+ * VSPM_IOC_CMD_WAIT_INTERRUPT.
+ */
+enum {
+	/* index: RPF number (0-4) */
+	VSPM_IF_PATCH_SRC_ADDR = 0,
+	VSPM_IF_PATCH_SRC_ADDR_C0,
+	VSPM_IF_PATCH_SRC_ADDR_C1,
+	VSPM_IF_PATCH_SRC_ADDR_A,
+	VSPM_IF_PATCH_DST_ADDR,
+	VSPM_IF_PATCH_DST_ADDR_C0,
+	VSPM_IF_PATCH_DST_ADDR_C1,
+	VSPM_IF_PATCH_FDP_PICID,
+	VSPM_IF_PATCH_FDP_CURRENT_FIELD,
+	VSPM_IF_PATCH_FDP_OUT_ADDR,
+	VSPM_IF_PATCH_FDP_OUT_ADDR_C0,
+	VSPM_IF_PATCH_FDP_OUT_ADDR_C1,
+	/* index: 0 = next, 1 = current, 2 = previous */
+	VSPM_IF_PATCH_FDP_REF_ADDR,
+	VSPM_IF_PATCH_FDP_REF_ADDR_C0,
+	VSPM_IF_PATCH_FDP_REF_ADDR_C1,
+};
+
+struct vspm_if_patch_t {
+	unsigned short target;
+	unsigned short index;
+	unsigned int value;
+};
+
+struct vspm_if_template_reg_t {
+	struct vspm_if_entry_flat_req_t req;
+	unsigned int handle;
+	unsigned int reserved;
+};
+
+struct vspm_if_template_entry_t {
+	struct vspm_if_template_entry_req_t {
+		unsigned long long patch;	/* address of patch array */
+		unsigned long long user_data;
+		unsigned int handle;
+		unsigned int patch_num;
+	} req;
+	struct vspm_if_entry_flat_rsp_t rsp;
+};
+
+#define VSPM_IOC_CMD_TEMPLATE_REG \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_TEMPLATE_REG, \
+	struct vspm_if_template_reg_t)
+#define VSPM_IOC_CMD_TEMPLATE_UNREG \
+	_IOR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_TEMPLATE_UNREG, \
+	unsigned int)
+#define VSPM_IOC_CMD_TEMPLATE_ENTRY \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_TEMPLATE_ENTRY, \
+	struct vspm_if_template_entry_t)
+
+/*
+ * configuration (common to 32bit and 64bit)
+ *
+ * depth is the number of entry slots preallocated for the file handle.
+ * When depth is not 0, the entry of a job uses a free slot instead of
+ * allocating memory, and the entry fails with -EBUSY if all slots are
+ * in use. depth 0 releases the slots. The configuration fails with
+ * -EBUSY while any slot is in use, and then nothing is changed.
+ *
+ * The same number of work buffers of work_size bytes is also reserved
+ * for the file handle, so that the first jobs do not allocate them.
+ * work_size 0 means a job without color table and histogram. A job of
+ * larger footprint still allocates its work buffer.
+ */
+struct vspm_if_config_t {
+	unsigned int depth;
+	unsigned int work_size;
+};
+
+#define VSPM_IOC_CMD_CONFIG \
+	_IOR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_CONFIG, \
+	struct vspm_if_config_t)
+
+/*
+ * completion ring (common to 32bit and 64bit)
+ *
+ * The completion ring is mapped by mmap() of VSPM_IF_CQ_SIZE bytes at
+ * offset VSPM_IF_MMAP_CQ. The driver writes the response of a finished
+ * job to rsp[tail % num] and increments tail, the user reads the
+ * records from head to tail and writes the new head. The response of
+ * a job with histogram (HGO/HGT) results, or of a job that finished
+ * while the ring was full, is received by VSPM_IOC_CMD_WAIT_INTERRUPT
+ * as before.
+ * VSPM_IOC_CMD_WAIT_INTERRUPT returns the response with ercd
+ * VSPM_IF_ERCD_CQ when no response is queued to it but the ring has
+ * records.
+ */
+#define VSPM_IF_MMAP_CQ			(0)
+#define VSPM_IF_ERCD_CQ			(1)
+
+struct vspm_if_cq_rsp_t {
+	unsigned long long cb_func;
+	unsigned long long user_data;
+	unsigned long long job_id;
+	long long result;
+	int ercd;
+	int reserved;
+};
+
+struct vspm_if_cq_t {
+	unsigned int head;	/* written by user */
+	unsigned int tail;	/* written by driver */
+	unsigned int num;
+	unsigned int reserved[13];
+	struct vspm_if_cq_rsp_t rsp[];
+};
+
+#define VSPM_IF_CQ_SIZE \
+	(sizeof(struct vspm_if_cq_t) + \
+	VSPM_IF_CQ_NUM * sizeof(struct vspm_if_cq_rsp_t))
+
+/*
+ * multiple response reception (common to 32bit and 64bit)
+ *
+ * VSPM_IOC_CMD_REAP waits until min responses are queued, a stop is
+ * requested or timeout microseconds pass (0: no timeout), then writes
+ * up to max responses of the callback list to the rsp array and
+ * returns the number of them in num. min 0 does not wait.
+ * The HGO/HGT results of the responses are copied in the same call.
+ * The responses in the completion ring are not received by it.
+ * If the rsp array faults, the responses not written are requeued and
+ * num tells how many were written; -EFAULT is returned if none.
+ */
+struct vspm_if_reap_t {
+	unsigned long long rsp;	/* address of vspm_if_cq_rsp_t array */
+	unsigned int max;
+	unsigned int min;
+	unsigned int timeout;
+	unsigned int num;
+};
+
+#define VSPM_IOC_CMD_REAP \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_REAP, \
+	struct vspm_if_reap_t)
+
+/*
+ * submission ring (common to 32bit and 64bit)
+ *
+ * The submission ring is mapped by mmap() of VSPM_IF_SQ_SIZE bytes at
+ * offset VSPM_IF_MMAP_SQ. The user writes flat job descriptors to the
+ * data area and the records to req[tail % num], then increments tail.
+ * In a record, job is the offset of the descriptor from the data area.
+ * VSPM_IOC_CMD_SQ_ENTER entries the jobs of the records from head to
+ * tail, and updates head. It stops at the first record that failed,
+ * and returns the number of consumed records (including the failed
+ * one) in num and the error in ercd. The job ID of an entered job is
+ * given by the response.
+ */
+#define VSPM_IF_MMAP_SQ			(0x10000000)
+
+struct vspm_if_sq_t {
+	unsigned int head;	/* written by driver */
+	unsigned int tail;	/* written by user */
+	unsigned int num;
+	unsigned int data_size;
+	unsigned int reserved[12];
+	struct vspm_if_entry_flat_req_t req[VSPM_IF_SQ_NUM];
+};
+
+#define VSPM_IF_SQ_DATA_OFFSET \
+	(sizeof(struct vspm_if_sq_t))
+#define VSPM_IF_SQ_SIZE \
+	(VSPM_IF_SQ_DATA_OFFSET + VSPM_IF_SQ_DATA_SIZE)
+
+struct vspm_if_sq_enter_t {
+	unsigned int num;
+	int ercd;
+};
+
+#define VSPM_IOC_CMD_SQ_ENTER \
+	_IOR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_SQ_ENTER, \
+	struct vspm_if_sq_enter_t)
+
+/*
+ * response reception with timeout (common to 32bit and 64bit)
+ *
+ * VSPM_IOC_CMD_WAIT_TIMEOUT works as VSPM_IOC_CMD_WAIT_INTERRUPT, and
+ * returns -ETIMEDOUT when no response is received within timeout
+ * nanoseconds. With VSPM_IF_WAIT_ABSTIME, timeout is the absolute time
+ * of CLOCK_MONOTONIC.
+ */
+#define VSPM_IF_WAIT_ABSTIME		(0x0001)
+
+struct vspm_if_wait_t {
+	unsigned long long timeout;
+	unsigned int flags;
+	unsigned int reserved;
+	struct vspm_if_cq_rsp_t rsp;
+};
+
+#define VSPM_IOC_CMD_WAIT_TIMEOUT \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_WAIT_TIMEOUT, \
+	struct vspm_if_wait_t)
+
+/*
+ * synchronous entry (common to 32bit and 64bit)
+ *
+ * VSPM_IOC_CMD_ENTRY_SYNC entries the job of a flat job descriptor and
+ * waits for the end of the job, then returns the response (and copies
+ * the HGO/HGT results). The response is not queued to the callback list
+ * or the completion ring. If the entry fails, rsp.ercd is the error of
+ * the entry. When the wait is interrupted, the job continues and its
+ * response is discarded.
+ */
+struct vspm_if_entry_sync_t {
+	struct vspm_if_entry_flat_req_t req;
+	struct vspm_if_cq_rsp_t rsp;
+};
+
+#define VSPM_IOC_CMD_ENTRY_SYNC \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_SYNC, \
+	struct vspm_if_entry_sync_t)
+
+/*
+ * job dependency graph (common to 32bit and 64bit)
+ *
+ * VSPM_IOC_CMD_ENTRY_GRAPH entries the jobs of flat job descriptors.
+ * dep of each job is the bit mask of the jobs (lower index only) which
+ * must end before the job. The driver entries a job when all of its
+ * dependencies have ended, without returning to user. Every job returns
+ * one response. When a dependency fails, the job is not entried and
+ * its response has ercd ECANCELED. When the entry fails, the response
+ * has the R_VSPM_* code of the entry.
+ * job_id returns the job ID of each job entried in the call, and 0 for
+ * a job entried later (its job ID is in its response). Cancelling a
+ * job with VSPM_IOC_CMD_CANCEL also cancels the jobs depending on it.
+ */
+struct vspm_if_graph_job_t {
+	struct vspm_if_entry_flat_req_t req;
+	unsigned int dep;
+	unsigned int reserved;
+	unsigned long long job_id;
+};
+
+struct vspm_if_entry_graph_t {
+	unsigned long long job;		/* address of graph_job array */
+	unsigned int num;
+	unsigned int reserved;
+};
+
+#define VSPM_IOC_CMD_ENTRY_GRAPH \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_GRAPH, \
+	struct vspm_if_entry_graph_t)
+
+/*
+ * extended entry (common to 32bit and 64bit)
+ *
+ * VSPM_IOC_CMD_ENTRY_EX entries the job of a flat job descriptor as
+ * VSPM_IOC_CMD_ENTRY_FLAT. With VSPM_IF_FENCE_OUT, fence_fd returns a
+ * sync_file fd of the fence which is signaled at the end of the job.
+ * The fence has an error when the job fails or is not executed.
+ * The response of the job is returned as usual.
+ *
+ * in_fence is the address of in_fence_num sync_file fds. The driver
+ * holds the job until all of the input fences are signaled. If the job
+ * is held, the ioctl returns rsp.job_id 0 and the result of the entry
+ * is reported by the response of the job. When an input fence has an
+ * error, the job is not entried and the response has ercd ECANCELED.
+ * If the error is known at the entry, rsp.ercd is also ECANCELED.
+ *
+ * dmabuf is the address of dmabuf_num imports of dma-buf. Each import
+ * sets the address field selected by target and index (the same as the
+ * template patch, address targets only) to the device address of the
+ * dma-buf fd plus offset. The dma-buf must be contiguous in the device
+ * address space. The driver keeps the attachments of up to
+ * VSPM_IF_DMABUF_CACHE_MAX dma-bufs for the file handle, so the same
+ * buffer is mapped only once. The cached dma-buf is kept until it is
+ * evicted by other dma-bufs or the file handle is closed.
+ */
+#define VSPM_IF_FENCE_OUT			(0x0001)
+
+struct vspm_if_dmabuf_t {
+	unsigned short target;
+	unsigned short index;
+	int fd;
+	unsigned int offset;
+	unsigned int reserved;
+};
+
+struct vspm_if_entry_ex_t {
+	struct vspm_if_entry_flat_req_t req;
+	unsigned int flags;
+	int fence_fd;			/* out: -1 without fence */
+	unsigned long long in_fence;	/* address of int array */
+	unsigned long long dmabuf;	/* address of dmabuf array */
+	unsigned int in_fence_num;
+	unsigned int dmabuf_num;
+	struct vspm_if_entry_flat_rsp_t rsp;
+};
+
+#define VSPM_IOC_CMD_ENTRY_EX \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_EX, \
+	struct vspm_if_entry_ex_t)
 
 /* for 32bit */
 struct vspm_compat_init_t {
@@ -137,6 +552,11 @@ struct vspm_compat_entry_t {
 	} rsp;
 };
 
+struct vspm_compat_entry_batch_t {
+	unsigned int num;
+	unsigned int entry;
+};
+
 struct vspm_compat_job_t {
 	unsigned short type;
 	union {
@@ -446,5 +866,9 @@ struct vspm_compat_cb_rsp_t {
 	_IOWR(VSPM_IOC_MAGIC, \
 	VSPM_CMD_WAIT_INTERRUPT, \
 	struct vspm_compat_cb_rsp_t)
+#define VSPM_IOC_CMD_ENTRY_BATCH32 \
+	_IOWR(VSPM_IOC_MAGIC, \
+	VSPM_CMD_ENTRY_BATCH, \
+	struct vspm_compat_entry_batch_t)
 
 #endif /* __VSPM_IF_H__ */